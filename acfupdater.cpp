@@ -13,6 +13,10 @@
  *   manifest      -- "0"  Steam fetches the real hash on next launch without
  *                         re-downloading files that are already on disk.
  *
+ * Size / dates come from the content folder's skin index (skinindex.h, kept
+ * in skinindex_cache/ next to this tool); only folders added or changed since
+ * the index last saw them are walked.
+ *
  * A timestamped backup is always written before any modification.
  * Run this while Steam is CLOSED (Steam holds a write lock on .acf).
  *
@@ -31,7 +35,8 @@
 #include <chrono>
 #include <ctime>
 #include <iomanip>
-#include <regex>
+
+#include "skinindex.h"
 
 namespace fs = std::filesystem;
 
@@ -133,87 +138,15 @@ struct SkinInfo {
     std::time_t timetouched = 0;
 };
 
-// Parse ISO-8601 string like "2025-02-04T12:09:39.8009705Z" -> time_t (UTC)
-static std::time_t parseIso8601(const std::string& s) {
-    std::regex re(R"((\d{4})-(\d{2})-(\d{2})T(\d{2}):(\d{2}):(\d{2}))");
-    std::smatch m;
-    if (!std::regex_search(s, m, re)) return 0;
-    std::tm tm{};
-    tm.tm_year  = std::stoi(m[1]) - 1900;
-    tm.tm_mon   = std::stoi(m[2]) - 1;
-    tm.tm_mday  = std::stoi(m[3]);
-    tm.tm_hour  = std::stoi(m[4]);
-    tm.tm_min   = std::stoi(m[5]);
-    tm.tm_sec   = std::stoi(m[6]);
-    tm.tm_isdst = 0;
-#ifdef _WIN32
-    return _mkgmtime(&tm);
-#else
-    return timegm(&tm);
-#endif
-}
-
-// Read the PublishDate from a skin's manifest.txt
-static std::time_t readManifestDate(const fs::path& skinDir) {
-    fs::path manifestPath = skinDir / "manifest.txt";
-    if (!fs::exists(manifestPath)) return 0;
-    std::ifstream f(manifestPath);
-    std::string line;
-    // Pattern:  "PublishDate": "2025-02-04T12:09:39.8009705Z"
-    // The )"  inside would break a raw string so we use a named delimiter.
-    std::regex re(R"re("PublishDate"\s*:\s*"([^"]+)")re");
-    while (std::getline(f, line)) {
-        std::smatch m;
-        if (std::regex_search(line, m, re))
-            return parseIso8601(m[1].str());
-    }
-    return 0;
-}
-
-// Total byte size of all regular files in a folder (recursive)
-static uintmax_t folderSize(const fs::path& p) {
-    uintmax_t total = 0;
-    try {
-        for (auto& e : fs::recursive_directory_iterator(p))
-            if (fs::is_regular_file(e))
-                total += fs::file_size(e);
-    } catch (...) {}
-    return total;
-}
-
-// Newest file mtime in a folder (fallback when manifest.txt is absent)
-static std::time_t folderNewestMtime(const fs::path& p) {
-    std::time_t newest = 0;
-    try {
-        for (auto& e : fs::recursive_directory_iterator(p)) {
-            if (!fs::is_regular_file(e)) continue;
-            auto ftime = fs::last_write_time(e);
-            auto sys   = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                             ftime - fs::file_time_type::clock::now()
-                             + std::chrono::system_clock::now());
-            std::time_t t = std::chrono::system_clock::to_time_t(sys);
-            if (t > newest) newest = t;
-        }
-    } catch (...) {}
-    return newest;
-}
-
-static bool folderHasFiles(const fs::path& p) {
-    try {
-        if (!fs::exists(p) || !fs::is_directory(p)) return false;
-        for (auto& e : fs::directory_iterator(p))
-            if (fs::is_regular_file(e) && fs::file_size(e) > 0) return true;
-    } catch (...) {}
-    return false;
-}
-
-static SkinInfo readSkinInfo(const fs::path& skinDir) {
+// Everything comes from the skin's index record; the folder is only walked
+// when the index found it new or changed.
+static SkinInfo skinInfoFromIndex(const skinindex::Entry& e) {
     SkinInfo si;
-    si.id          = skinDir.filename().string();
-    si.size        = folderSize(skinDir);
+    si.id          = std::to_string(e.id);
+    si.size        = e.size;
     si.timetouched = std::time(nullptr);
-    std::time_t mdate = readManifestDate(skinDir);
-    si.timeupdated = (mdate > 0) ? mdate : folderNewestMtime(skinDir);
+    si.timeupdated = (e.manifestTime > 0) ? (std::time_t)e.manifestTime
+                                          : (std::time_t)e.newestMtime;
     return si;
 }
 
@@ -506,21 +439,28 @@ int main() {
     int skippedCount = 0;
     int emptyCount   = 0;
 
-    try {
-        std::vector<fs::directory_entry> entries;
-        for (auto& e : fs::directory_iterator(contentDir))
-            if (e.is_directory()) entries.push_back(e);
+    {
+        skinindex::Index index(contentDir, skinindex::cachedIndexFile(contentDir));
+        index.open();
+        try {
+            index.refresh();
+        } catch (const std::exception& ex) {
+            log("ERROR scanning content folder: " + std::string(ex.what()), Col::Red);
+            std::cout << "\nPress Enter to exit..."; std::cin.get(); return 1;
+        }
 
+        // Sorted by folder name; each name is built once
+        std::vector<std::pair<std::string, skinindex::Entry>> entries;
+        for (auto& e : index.entries(true))
+            entries.emplace_back(std::to_string(e.id), e);
         std::sort(entries.begin(), entries.end(),
-            [](const fs::directory_entry& a, const fs::directory_entry& b) {
-                return a.path().filename().string() < b.path().filename().string();
-            });
+            [](const auto& a, const auto& b) { return a.first < b.first; });
 
-        for (auto& entry : entries) {
-            std::string name = entry.path().filename().string();
-            if (!isAllDigits(name)) continue;
+        for (auto& named : entries) {
+            const std::string&      name  = named.first;
+            const skinindex::Entry& entry = named.second;
 
-            if (!folderHasFiles(entry.path())) {
+            if (!skinindex::present(entry)) {
                 emptyCount++;
                 log("SKIP empty : " + name, Col::Yellow);
                 continue;
@@ -535,9 +475,9 @@ int main() {
                 continue;
             }
 
-            SkinInfo si = readSkinInfo(entry.path());
+            SkinInfo si = skinInfoFromIndex(entry);
 
-            bool hasManifest = fs::exists(entry.path() / "manifest.txt") && si.timeupdated > 0;
+            bool hasManifest = entry.manifestTime > 0;
             logFile << "[" << ts() << "] QUEUE " << name
                     << " size=" << si.size
                     << " timeupdated=" << si.timeupdated
@@ -545,9 +485,6 @@ int main() {
 
             toAdd.push_back(si);
         }
-    } catch (const std::exception& ex) {
-        log("ERROR scanning content folder: " + std::string(ex.what()), Col::Red);
-        std::cout << "\nPress Enter to exit..."; std::cin.get(); return 1;
     }
 
     // -------------------------------------------------------------------------
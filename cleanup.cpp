@@ -10,6 +10,9 @@
  *   5. Remove the instances/ folder itself if it is fully empty.
  *   6. Clean up the temp_scripts folder.
  *
+ * Skins moved in are recorded in the shared skin index (skinindex.h), so the
+ * downloader, installer and .acf patcher don't have to rescan them.
+ *
  * Build (MSVC):  cl /std:c++17 /O2 cleanup.cpp /Fe:cleanup.exe
  * Build (MinGW): g++ -std=c++17 -O2 cleanup.cpp -o cleanup.exe
  */
@@ -23,6 +26,8 @@
 #include <iomanip>
 #include <sstream>
 
+#include "skinindex.h"
+
 namespace fs = std::filesystem;
 
 // =============================================================================
@@ -83,15 +88,6 @@ static void log(const std::string& msg, const char* col = Col::Reset) {
     std::cout << col << "[" << ts() << "] " << msg << Col::Reset << "\n";
 }
 
-static bool folderHasFiles(const fs::path& p) {
-    try {
-        if (!fs::exists(p) || !fs::is_directory(p)) return false;
-        for (auto& e : fs::directory_iterator(p))
-            if (fs::is_regular_file(e) && fs::file_size(e) > 0) return true;
-    } catch (...) {}
-    return false;
-}
-
 // True when the directory contains zero regular files at any depth.
 static bool dirIsEmpty(const fs::path& p) {
     try {
@@ -103,6 +99,9 @@ static bool dirIsEmpty(const fs::path& p) {
     return false;
 }
 
+// Shared content dir index; "already present" checks cost one stat per skin.
+static skinindex::Index sharedIndex(CONTENT_PATH);
+
 // =============================================================================
 //  STEP 1 -- Discover all instance directories inside INSTANCES_ROOT
 // =============================================================================
@@ -176,7 +175,8 @@ static MoveResult moveSkinsFromInstance(const fs::path& instanceDir) {
             fs::path dst = fs::path(CONTENT_PATH) / skinId;
 
             // Already in shared dir -- remove duplicate and skip
-            if (folderHasFiles(dst)) {
+            skinindex::Entry have;
+            if (sharedIndex.lookup(skinId, have) && skinindex::present(have)) {
                 r.already++;
                 try { fs::remove_all(entry.path()); } catch (...) {}
                 continue;
@@ -186,7 +186,7 @@ static MoveResult moveSkinsFromInstance(const fs::path& instanceDir) {
             try {
                 fs::create_directories(dst.parent_path());
                 fs::rename(entry.path(), dst);
-                if (folderHasFiles(dst)) {
+                if (sharedIndex.rescan(skinId)) {
                     r.moved++;
                 } else {
                     r.failed++;
@@ -199,7 +199,7 @@ static MoveResult moveSkinsFromInstance(const fs::path& instanceDir) {
                              fs::copy_options::recursive |
                              fs::copy_options::overwrite_existing);
                     fs::remove_all(entry.path());
-                    if (folderHasFiles(dst))
+                    if (sharedIndex.rescan(skinId))
                         r.moved++;
                     else
                         r.failed++;
@@ -277,6 +277,7 @@ int main() {
 
     // Ensure shared content destination exists
     try { fs::create_directories(CONTENT_PATH); } catch (...) {}
+    sharedIndex.open();
 
     // -- Discover instance dirs -------------------------------------------
     auto instances = findInstanceDirs();
@@ -7,12 +7,67 @@
  *      a successful download the skin folder is moved to the shared content path.
  *  [2] STAGED FILE VALIDATION / MISSING UPDATE FILES – stale partial downloads
  *      in the steamcmd "downloads/" staging folder are wiped before every run
- *      and before every retry pass, so corrupted stage files can't block items.
+ *      and before an item is retried, so corrupted stage files can't block items.
  *  [3] New result categories: LockFailed, ValidationFailed (both auto-retried).
  *  [4] Smarter log parsing: detects all result lines steamcmd actually writes.
+ *  [5] steamcmd is spawned directly (no shell) in its own process group /
+ *      job object, so a hard timeout kills only the instance that hung instead
+ *      of every steamcmd on the box.
+ *  [6] One supervisor thread drives all instances through an event loop
+ *      (epoll + pidfd on Linux) instead of three threads per instance.
+ *  [7] Persistent sessions: each instance logs in once and is fed items over
+ *      stdin as they are needed, instead of re-launching steamcmd per batch.
+ *  [8] One template instance is bootstrapped and reflink-cloned (copied where
+ *      the filesystem can't) into every rust_workshop_tN dir.
+ *  [9] Failed items are retried right away with per-item backoff and an
+ *      attempt budget, alongside first attempts, instead of in later passes.
+ * [10] Live instance count follows an AIMD controller fed by the RateLimit /
+ *      LockFailed / Timeout rate; the prompt value is only the ceiling.
+ * [11] Item dispatch draws from one token bucket shared by all instances; a
+ *      rate limit halves its rate for everyone, which then recovers slowly.
+ * [12] Hung instances are found by lack of progress (result lines, bytes in
+ *      the download/content dirs) instead of a timeout scaled by chunk size.
+ * [13] Linux: inotify on each instance's content dir moves a skin to the
+ *      shared dir the moment steamcmd renames it into place.
+ * [14] Moves and their verification run on a small I/O thread pool behind a
+ *      bounded queue; the supervisor only hands off (instanceDir, id).
+ * [15] The shared content dir is indexed once at startup (parallel non-empty
+ *      check); skip filtering and moves query the index.
+ * [16] That index is a memory-mapped file (skinindex.h) shared with cleanup,
+ *      the skin installer and the .acf patcher; startup only walks folders
+ *      whose mtime / inode changed since the index last saw them.
+ * [17] Skin IDs are parsed once into 64-bit integers; per-item results and
+ *      attempt counts live in dense arrays indexed by work-list position.
+ * [18] ImportedSkins.json is memory-mapped and scanned for IDs in one linear
+ *      pass (memchr quote to quote) instead of a regex per line.
+ * [19] ImportedSkins.json is parsed as JSON into a columnar skin catalog
+ *      (interned shortname / permission, one display-name arena); failed
+ *      items are reported and logged with their item type.
+ * [20] Optional priority.txt orders dispatch by skin ID, item shortname or
+ *      permission; the work queue keeps one FIFO per rank, retries included.
+ * [21] Every dispatch and result is appended to download_journal.txt
+ *      (batched write + fsync); after a crash or kill the next start can
+ *      resume from it instead of redoing finished skins.
+ * [22] Ctrl+C / SIGTERM drains: no new work, running instances get
+ *      DRAIN_GRACE_SEC, finished skins are moved and the report written.
+ *      A second Ctrl+C kills every instance and exits at once.
+ * [23] steamcmd output is split with memchr and classified by hand-written
+ *      matchers instead of up to seven std::regex searches per line.
+ * [24] The log parser lives in steamcmdlog.h; parserbench replays the logs in
+ *      parser_corpus/ against their expected results and measures it.
+ * [25] Logging is asynchronous: callers push time-stamped lines into a
+ *      lock-free bounded ring, one writer thread batches them to main.log
+ *      and the console (replaces fileMtx / coutMtx).
+ * [26] Optional logs/events.jsonl: one line per item state change (queued,
+ *      dispatched, result, moved, verified) with steady-clock timestamps,
+ *      attempt and result, for per-item latency analysis.
+ * [27] Optional logs/trace.json (Chrome trace events): a timeline track per
+ *      instance slot (spawn, login, items, staging cleanup) and per mover
+ *      thread, plus retry backoffs and the live instance limit.
  *
  * Build (MSVC):  cl /std:c++17 /O2 workshop_downloader.cpp /Fe:downloader.exe
  * Build (MinGW): g++ -std=c++17 -O2 workshop_downloader.cpp -o downloader.exe
+ * Build (Linux): g++ -std=c++17 -O2 -pthread workshop_downloader.cpp -o downloader
  */
 
 #include <iostream>
@@ -20,10 +75,13 @@
 #include <sstream>
 #include <vector>
 #include <string>
-#include <regex>
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
 #include <filesystem>
 #include <chrono>
 #include <cstdlib>
@@ -32,6 +90,32 @@
 #include <algorithm>
 #include <iomanip>
 #include <ctime>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+#include "skinindex.h"
+#include "steamcmdlog.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/fs.h>       // FICLONE
+extern char** environ;
+#endif
 
 namespace fs = std::filesystem;
 using Clock  = std::chrono::steady_clock;
@@ -46,15 +130,92 @@ const std::string CONTENT_PATH    = SHARED_DIR + "/steamapps/workshop/content/"
 // Per-instance install dir template – threadId is appended at runtime.
 const std::string INSTANCES_ROOT  = "instances";
 const std::string INST_DIR_PREFIX = INSTANCES_ROOT + "/rust_workshop_t";
+// Bootstrapped once by steamcmd, then cloned into every instance dir.
+const std::string TEMPLATE_DIR    = INSTANCES_ROOT + "/template";
+// Written once a bootstrap run exited cleanly; without it the next start bootstraps again.
+const std::string TEMPLATE_STAMP  = INSTANCES_ROOT + "/template.ready";
 const std::string LOG_DIR         = "logs";
 const std::string TEMP_DIR        = "temp_scripts";
 const std::string FAILED_IDS_FILE = "failed_ids.txt";
 const std::string REPORT_FILE     = "download_report.txt";
+// Optional dispatch order, one rule per line, most important first: a skin ID,
+// "shortname=rifle.ak" or "permission=skinner.vip" (a trailing * matches a
+// prefix: "shortname=rifle.*"). Skins no rule matches go last, in file order.
+const std::string PRIORITY_FILE   = "priority.txt";
+// Append-only record of every dispatch and result, written to disk in batches
+// at most JOURNAL_SYNC_MS apart. A run that dies early leaves it behind and the
+// next start offers to resume from it; it is removed once the report is written.
+const std::string JOURNAL_FILE    = "download_journal.txt";
+const int JOURNAL_SYNC_MS         = 1000;
+// Per-item timing: one JSON line per state change of every item (queued,
+// dispatched, result, moved, verified) with steady-clock timestamps.
+const bool WRITE_EVENT_STREAM     = false;
+const std::string EVENTS_FILE     = LOG_DIR + "/events.jsonl";
+// Timeline of what every instance slot and mover thread spends its time on,
+// in Chrome trace-event format (open in ui.perfetto.dev or chrome://tracing).
+const bool WRITE_TRACE            = false;
+const std::string TRACE_FILE      = LOG_DIR + "/trace.json";
+#ifdef _WIN32
+const std::string STEAMCMD_BIN    = "steamcmd.exe";
+#else
+const std::string STEAMCMD_BIN    = "steamcmd.sh";
+#endif
 
-const int BASE_TIMEOUT_SEC        = 90;   // per-item; instance timeout = BASE * chunk.size()
+// An instance with no new result line and no byte change in its downloads /
+// content dirs for this long is killed; items it had not started are requeued.
+const int STALL_WINDOW_SEC        = 90;
+const int DISPATCH_BATCH_SIZE     = 10;   // max items handed to one steamcmd run
+const int STEAL_MIN_ITEMS         = 1;    // only steal from instances with this many not yet started
+// Persistent sessions: each instance logs in once and is fed
+// workshop_download_item commands over stdin as work becomes available.
+// false = one "+runscript" steamcmd run per batch.
+const bool PERSISTENT_SESSIONS    = true;
+const int SESSION_PIPELINE_DEPTH  = 2;    // commands queued inside one session (1 downloading + next)
+// A session that ends before its first result line (steamcmd won't start or
+// quits at login) is restarted after SESSION_RESTART_SEC, doubled each time;
+// after SESSION_FAIL_LIMIT in a row the slot is given up for this run.
+const int SESSION_RESTART_SEC     = 5;
+const int SESSION_FAIL_LIMIT      = 3;
 const int STATUS_POLL_MS          = 500;
-const int MAX_RETRY_PASSES        = 3;    // extra passes (LockFailed/Validation get extra chance)
-const int RATELIMIT_BACKOFF_SEC   = 30;
+const int MAX_ITEM_RETRIES        = 3;    // per item, after the first attempt
+const int RETRY_BACKOFF_SEC       = 5;    // delay before a retry, doubled for each further one
+// Adaptive concurrency (AIMD): the instance count entered at the prompt is the
+// ceiling. Each window the share of RateLimit/LockFailed/Timeout results
+// decides: above AIMD_BAD_RATE → multiply by AIMD_DECREASE, otherwise grow
+// (doubling until the first decrease, then +1 per window).
+const bool ADAPTIVE_CONCURRENCY   = true;
+const int AIMD_INITIAL            = 4;    // instances at start (capped by the ceiling)
+const int AIMD_WINDOW_SEC         = 10;   // minimum time between decisions
+const int AIMD_MIN_SAMPLES        = 5;    // results needed before a decision
+const double AIMD_BAD_RATE        = 0.2;
+const double AIMD_DECREASE        = 0.5;
+const int RATELIMIT_BACKOFF_SEC   = 30;   // min retry delay for a rate-limited item / between rate cuts
+// Global dispatch limiter: every workshop_download_item (any instance) takes a
+// token. A rate limit halves the refill rate and empties the bucket; the rate
+// then climbs back by 10% of DISPATCH_RATE_PER_SEC every DISPATCH_RECOVER_SEC.
+const double DISPATCH_RATE_PER_SEC = 10.0;
+const int DISPATCH_BURST          = 30;
+const double DISPATCH_RATE_MIN    = 0.1;
+const int DISPATCH_RECOVER_SEC    = 30;
+const int KILL_GRACE_MS           = 3000; // SIGTERM -> SIGKILL delay for a hung instance (Linux)
+// Ctrl+C / SIGTERM: no new work, running instances get this long to finish
+// what they started before they are killed. A second Ctrl+C quits at once.
+const int DRAIN_GRACE_SEC         = 30;
+// Log lines go through a bounded queue to one writer thread. When it is full
+// LOG_DROP_WHEN_FULL drops the line (the count goes to main.log); otherwise
+// the caller waits for room.
+const int LOG_QUEUE_SIZE          = 8192;
+const bool LOG_DROP_WHEN_FULL     = false;
+const bool USE_INSTANCE_TEMPLATE  = true; // false = every instance dir bootstraps itself
+const int TEMPLATE_TIMEOUT_SEC    = 600;  // first run may include the steamcmd self-update
+// Raw steamcmd output is parsed live from the pipe; the per-instance copy in
+// logs/instance_pX_tY.log is for diagnostics only.
+const bool WRITE_INSTANCE_LOGS    = true;
+// Move a finished skin as soon as steamcmd renames it into the instance's
+// content dir (inotify, Linux only) rather than when its result line arrives.
+const bool MOVE_ON_FINALIZE       = true;
+const int MOVER_THREADS           = 4;    // skin move/verify threads (0 = on the supervisor)
+const int MOVER_QUEUE_MAX         = 256;  // pending moves before handing off blocks
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  ANSI COLOURS
@@ -86,34 +247,16 @@ static void enableAnsi() {}
 // ─────────────────────────────────────────────────────────────────────────────
 //  RESULT CATEGORIES
 // ─────────────────────────────────────────────────────────────────────────────
-enum class SkinResult {
-    Success,
-    Skipped,
-    Timeout,
-    RateLimit,
-    LockFailed,       // "result : Locking Failed" – file locked by parallel instance
-    ValidationFailed, // "Staged file validation failed" – stale/corrupt staging files
-    Error,
-    Unknown
-};
-
-static std::string resultName(SkinResult r) {
-    switch (r) {
-        case SkinResult::Success:          return "Success";
-        case SkinResult::Skipped:          return "Skipped";
-        case SkinResult::Timeout:          return "Timeout";
-        case SkinResult::RateLimit:        return "RateLimit";
-        case SkinResult::LockFailed:       return "LockFailed";
-        case SkinResult::ValidationFailed: return "ValidationFailed";
-        case SkinResult::Error:            return "Error";
-        default:                           return "Unknown";
-    }
-}
+// SkinResult, resultName() and the steamcmd log parser live in steamcmdlog.h,
+// shared with parserbench.
+using steamcmdlog::SkinResult;
+using steamcmdlog::resultName;
+using steamcmdlog::ParsedLog;
+using steamcmdlog::SteamCmdLogParser;
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  SHARED STATE
 // ─────────────────────────────────────────────────────────────────────────────
-std::mutex coutMtx;
 std::mutex resultMtx;
 
 std::atomic<int> successCount(0);
@@ -125,41 +268,368 @@ std::atomic<int> ratelimitCount(0);
 std::atomic<int> lockFailCount(0);
 std::atomic<int> validationFailCount(0);
 std::atomic<int> totalProcessed(0);
-std::atomic<bool> anyRateLimitDetected(false);
+std::atomic<int> retryWaiting(0);   // failed items waiting for their next attempt
+
+// Skin IDs are parsed once into integers; they only become text again where
+// they leave the program (steamcmd commands, paths, logs, report files).
+using SkinId = std::uint64_t;
+
+static std::string idStr(SkinId id) { return std::to_string(id); }
+
+// What ImportedSkins.json says about each skin: one row per unique ID, in
+// order of first appearance. Stored by column – shortnames and permissions
+// are interned (a handful of distinct values however many skins there are),
+// display names share one string arena. The loader appends a row per
+// occurrence; finish() folds repeats into the first one and builds the
+// open-addressed ID -> row table. Read-only afterwards.
+class SkinCatalog {
+public:
+    static constexpr size_t npos = (size_t)-1;
+
+    SkinCatalog() { intern(""); }
+
+    size_t append(SkinId id) {
+        ids.push_back(id);
+        shortIdx.push_back(0);
+        permIdx.push_back(0);
+        nameOff.push_back(0);
+        nameLen.push_back(0);
+        return ids.size() - 1;
+    }
+
+    void setShortname(size_t row, std::string_view v)  { shortIdx[row] = intern(v); }
+    void setPermission(size_t row, std::string_view v) { permIdx[row]  = intern(v); }
+    void setDisplayName(size_t row, std::string_view v) {
+        nameOff[row] = (std::uint32_t)arena.size();
+        nameLen[row] = (std::uint32_t)v.size();
+        arena.append(v.data(), v.size());
+    }
+
+    // Drop repeated IDs (fields given on a later occurrence win) and index
+    // the rest. The table is sized once, at least twice the row count.
+    void finish() {
+        int bits = 4;
+        while (((size_t)1 << bits) < ids.size() * 2) ++bits;
+        slots.assign((size_t)1 << bits, Slot());
+        slotShift = 64 - bits;
+        size_t kept = 0;
+        for (size_t r = 0; r < ids.size(); ++r) {
+            Slot& sl = slots[probe(ids[r])];
+            if (sl.id == ids[r]) {
+                size_t f = sl.row;
+                if (shortIdx[r]) shortIdx[f] = shortIdx[r];
+                if (permIdx[r])  permIdx[f]  = permIdx[r];
+                if (nameLen[r])  { nameOff[f] = nameOff[r]; nameLen[f] = nameLen[r]; }
+                continue;
+            }
+            sl = { ids[r], (std::uint32_t)kept };
+            ids[kept]      = ids[r];
+            shortIdx[kept] = shortIdx[r];
+            permIdx[kept]  = permIdx[r];
+            nameOff[kept]  = nameOff[r];
+            nameLen[kept]  = nameLen[r];
+            kept++;
+        }
+        for (auto* col : { &shortIdx, &permIdx, &nameOff, &nameLen }) {
+            col->resize(kept);
+            col->shrink_to_fit();
+        }
+        ids.resize(kept);
+        ids.shrink_to_fit();
+    }
+
+    size_t row(SkinId id) const {
+        if (slots.empty()) return npos;
+        const Slot& sl = slots[probe(id)];
+        return sl.id == id ? sl.row : npos;
+    }
+
+    size_t             size()                 const { return ids.size(); }
+    SkinId             id(size_t row)          const { return ids[row]; }
+    const std::string& shortname(size_t row)   const { return pool[shortIdx[row]]; }
+    const std::string& permission(size_t row)  const { return pool[permIdx[row]]; }
+    std::string        displayName(size_t row) const { return arena.substr(nameOff[row], nameLen[row]); }
+    const std::vector<SkinId>& allIds()        const { return ids; }
+
+    size_t distinctShortnames() const {
+        std::vector<bool> used(pool.size(), false);
+        size_t n = 0;
+        for (auto i : shortIdx)
+            if (i != 0 && !used[i]) { used[i] = true; n++; }
+        return n;
+    }
+
+private:
+    struct Slot {
+        SkinId        id  = 0;                       // 0 = free (no skin ID is 0)
+        std::uint32_t row = 0;
+    };
+
+    std::vector<SkinId>        ids;
+    std::vector<std::uint32_t> shortIdx, permIdx;    // into pool, 0 = not given
+    std::vector<std::uint32_t> nameOff, nameLen;     // into arena
+    std::string                arena;
+    std::vector<std::string>   pool;
+    std::unordered_map<std::string, std::uint32_t> poolIdx;
+    std::uint32_t              lastIntern = 0;
+    std::vector<Slot>          slots;
+    int                        slotShift  = 60;
+
+    std::uint32_t intern(std::string_view v) {
+        if (!pool.empty() && pool[lastIntern] == v) return lastIntern; // runs of one item type
+        auto ins = poolIdx.emplace(std::string(v), (std::uint32_t)pool.size());
+        if (ins.second) pool.emplace_back(v);
+        return lastIntern = ins.first->second;
+    }
+
+    size_t probe(SkinId id) const {
+        size_t mask = slots.size() - 1;
+        size_t h    = (size_t)((id * 0x9E3779B97F4A7C15ull) >> slotShift);
+        while (slots[h].id != 0 && slots[h].id != id) h = (h + 1) & mask;
+        return h;
+    }
+};
+
+SkinCatalog catalog;
+
+// Result, attempt count and dispatch rank of every catalog row, in dense
+// arrays indexed by the row (the ID's position in the work list).
+class ItemTable {
+public:
+    static constexpr std::uint32_t UNRANKED = (std::uint32_t)-1;
+
+    void assign(size_t rows) {
+        results.assign(rows, SkinResult::Unknown);
+        tries.assign(rows, 0);
+        ranks.assign(rows, UNRANKED);
+    }
+
+    size_t     size()               const { return results.size(); }
+    SkinResult resultAt(size_t row) const { return results[row]; }
 
-std::unordered_map<std::string, SkinResult> skinResults;
+    // Every ID handled here came from the catalog.
+    SkinResult&   result(SkinId id)   { return results[catalog.row(id)]; }
+    std::uint8_t& attempts(SkinId id) { return tries[catalog.row(id)]; } // supervisor thread only
+    std::uint32_t rankAt(size_t row)  const { return ranks[row]; }
+    std::uint32_t rank(SkinId id)     const { return ranks[catalog.row(id)]; }
+    void          setRank(size_t row, std::uint32_t r) { ranks[row] = std::min(ranks[row], r); }
+
+private:
+    std::vector<SkinResult>    results; // Unknown = no final result yet
+    std::vector<std::uint8_t>  tries;
+    std::vector<std::uint32_t> ranks;   // PRIORITY_FILE line of the first matching rule
+};
+ItemTable itemTable;
+
+// "1234567 (rifle.ak)" for log lines; just the ID if the config had no shortname.
+static std::string itemLabel(SkinId id) {
+    size_t row = catalog.row(id);
+    if (row == SkinCatalog::npos || catalog.shortname(row).empty()) return idStr(id);
+    return idStr(id) + " (" + catalog.shortname(row) + ")";
+}
+
+// Skins in CONTENT_PATH, backed by the on-disk index shared with the other
+// tools. Reconciled once at startup, kept current by moveSkinToShared.
+skinindex::Index presentSkins(CONTENT_PATH);
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  LOGGING
+//
+//  fileLog / logMain never wait on I/O. The caller stamps the time and pushes
+//  the line into a bounded ring (a sequence number per slot: any number of
+//  producers, one consumer, no locks). One writer thread drains whatever has
+//  collected and writes it to main.log and the console with one call each.
+//  Anything else that prints to the console calls logFlush() first so it
+//  can't overtake queued lines.
 // ─────────────────────────────────────────────────────────────────────────────
-static std::string timestamp() {
-    auto t  = std::time(nullptr);
-    auto tm = *std::localtime(&t);
-    std::ostringstream ss;
-    ss << std::put_time(&tm, "%H:%M:%S");
-    return ss.str();
+static std::string clockText(std::time_t t) {
+    std::tm tm{};
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    char buf[16];
+    std::strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+    return buf;
 }
 
-static std::mutex fileMtx;
-static std::ofstream mainLogFile;
+static std::string timestamp() { return clockText(std::time(nullptr)); }
+
+class AsyncLog {
+public:
+    enum class Sink : std::uint8_t {
+        File,       // main.log only
+        Both,       // main.log + console, coloured
+        Console     // console as-is (progress bar)
+    };
+
+    explicit AsyncLog(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        slots = std::vector<Slot>(n);
+        mask  = n - 1;
+        for (size_t i = 0; i < n; ++i) slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~AsyncLog() { stop(); }
+
+    void start(const std::string& path) {
+        file.open(path, std::ios::out | std::ios::app);
+        writer = std::thread([this] { run(); });
+    }
+
+    // Write everything still queued and end the writer thread.
+    void stop() {
+        if (!writer.joinable()) return;
+        stopping = true;
+        wakeWriter();
+        writer.join();
+        if (file.is_open()) file.close();
+    }
+
+    void push(Sink sink, const char* colour, std::string text) {
+        Record rec{ std::time(nullptr), sink, colour, std::move(text) };
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot&     slot = slots[pos & mask];
+            size_t    seq  = slot.seq.load(std::memory_order_acquire);
+            std::ptrdiff_t lag = (std::ptrdiff_t)(seq - pos);
+            if (lag == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.rec = std::move(rec);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the writer's
+                    if (idle.load()) wakeWriter();
+                    return;
+                }
+            } else if (lag < 0) {           // full: the writer hasn't freed this slot yet
+                if (LOG_DROP_WHEN_FULL || !writer.joinable()) {
+                    dropped++;
+                    return;
+                }
+                wakeWriter();
+                std::this_thread::yield();
+                pos = tail.load(std::memory_order_relaxed);
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Wait until everything pushed so far is written.
+    void flush() {
+        if (!writer.joinable()) return;
+        size_t target = tail.load(std::memory_order_acquire);
+        while (written.load(std::memory_order_acquire) < target) {
+            wakeWriter();
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Record {
+        std::time_t time   = 0;
+        Sink        sink   = Sink::File;
+        const char* colour = nullptr;
+        std::string text;
+    };
+    struct Slot {
+        std::atomic<size_t> seq{0};   // == position: free, position + 1: holds a record
+        Record              rec;
+    };
+
+    std::vector<Slot>       slots;
+    size_t                  mask = 0;
+    std::atomic<size_t>     tail{0};
+    std::atomic<size_t>     written{0};
+    std::atomic<size_t>     dropped{0};
+    std::atomic<bool>       idle{false};
+    std::atomic<bool>       stopping{false};
+    std::mutex              idleMtx;  // only for the writer's sleep
+    std::condition_variable idleCv;
+    std::thread             writer;
+    std::ofstream           file;
+
+    void wakeWriter() {
+        std::lock_guard<std::mutex> lk(idleMtx);
+        idleCv.notify_one();
+    }
+
+    void run() {
+        std::string fileBuf, consoleBuf, stamp;
+        std::time_t stampTime = -1;
+        size_t      head      = 0;
+        auto ready = [&] {
+            return slots[head & mask].seq.load(std::memory_order_acquire) == head + 1;
+        };
+        for (;;) {
+            while (ready()) {
+                Slot&  slot = slots[head & mask];
+                Record rec  = std::move(slot.rec);
+                slot.seq.store(head + mask + 1, std::memory_order_release);
+                head++;
+
+                if (rec.time != stampTime) {
+                    stampTime = rec.time;
+                    stamp     = "[" + clockText(rec.time) + "] ";
+                }
+                if (rec.sink == Sink::Console) {
+                    consoleBuf += rec.text;
+                    continue;
+                }
+                fileBuf += stamp;
+                fileBuf += rec.text;
+                fileBuf += '\n';
+                if (rec.sink == Sink::Both) {
+                    consoleBuf += '\n';
+                    consoleBuf += rec.colour;
+                    consoleBuf += stamp;
+                    consoleBuf += rec.text;
+                    consoleBuf += Col::Reset;
+                }
+            }
+            if (size_t lost = dropped.exchange(0))
+                fileBuf += "[" + timestamp() + "] [WARN] " + std::to_string(lost)
+                         + " log line(s) dropped – log queue full\n";
+            if (!fileBuf.empty() && file.is_open()) {
+                file.write(fileBuf.data(), (std::streamsize)fileBuf.size());
+                file.flush();
+            }
+            if (!consoleBuf.empty()) {
+                std::cout.write(consoleBuf.data(), (std::streamsize)consoleBuf.size());
+                std::cout.flush();
+            }
+            fileBuf.clear();
+            consoleBuf.clear();
+            written.store(head, std::memory_order_release);
+
+            std::unique_lock<std::mutex> lk(idleMtx);
+            if (ready()) continue;
+            if (stopping) return;
+            idle = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);     // idle, then re-check the ring
+            idleCv.wait(lk, [&] { return ready() || stopping; });
+            idle = false;
+        }
+    }
+};
+AsyncLog asyncLog(LOG_QUEUE_SIZE);
 
 static void fileLog(const std::string& msg) {
-    std::lock_guard<std::mutex> lk(fileMtx);
-    if (mainLogFile.is_open())
-        mainLogFile << "[" << timestamp() << "] " << msg << "\n";
+    asyncLog.push(AsyncLog::Sink::File, nullptr, msg);
 }
 
 static void logMain(const std::string& msg, const char* colour = Col::White) {
-    std::lock_guard<std::mutex> lock(coutMtx);
-    std::cout << "\n" << colour << "[" << timestamp() << "] " << msg << Col::Reset;
-    std::cout.flush();
-    fileLog(msg);
+    asyncLog.push(AsyncLog::Sink::Both, colour, msg);
 }
 
+static void logFlush() { asyncLog.flush(); }
+
 // ─────────────────────────────────────────────────────────────────────────────
 //  PROGRESS BAR
 // ─────────────────────────────────────────────────────────────────────────────
-static void printProgress(int total, int pass, int maxPass) {
+static void printProgress(int total) {
     int done  = totalProcessed.load();
     int succ  = successCount.load();
     int skip  = skippedCount.load();
@@ -169,29 +639,30 @@ static void printProgress(int total, int pass, int maxPass) {
     int rl    = ratelimitCount.load();
     int lk    = lockFailCount.load();
     int vf    = validationFailCount.load();
+    int retry = retryWaiting.load();
     int rem   = std::max(0, total - done);
 
     float pct   = total > 0 ? (done * 100.f / total) : 0.f;
     const int W = 28;
     int filled  = static_cast<int>(W * pct / 100.f);
 
-    std::lock_guard<std::mutex> lock(coutMtx);
-    std::cout << "\r\033[K";
-    std::cout << Col::Cyan  << "[Pass " << pass << "/" << maxPass << "] " << Col::Reset;
-    std::cout << Col::Bold  << "[";
+    std::ostringstream out;
+    out << "\r\033[K";
+    out << Col::Bold  << "[";
     for (int i = 0; i < W; ++i)
-        std::cout << (i < filled ? '=' : (i == filled ? '>' : ' '));
-    std::cout << "] " << std::fixed << std::setprecision(1) << pct << "% ";
-    std::cout << Col::Green   << "OK:"   << succ                    << Col::Reset << " ";
-    std::cout << Col::Yellow  << "Skip:" << skip                    << Col::Reset << " ";
-    std::cout << Col::Red     << "Fail:" << fail;
-    std::cout << "(T:"  << tmt;
-    std::cout << " E:"  << err;
-    std::cout << " RL:" << rl;
-    std::cout << " LK:" << lk;
-    std::cout << " VF:" << vf << ")"                                << Col::Reset << " ";
-    std::cout << "Rem:" << rem << Col::Reset;
-    std::cout.flush();
+        out << (i < filled ? '=' : (i == filled ? '>' : ' '));
+    out << "] " << std::fixed << std::setprecision(1) << pct << "% ";
+    out << Col::Green   << "OK:"   << succ                    << Col::Reset << " ";
+    out << Col::Yellow  << "Skip:" << skip                    << Col::Reset << " ";
+    out << Col::Red     << "Fail:" << fail;
+    out << "(T:"  << tmt;
+    out << " E:"  << err;
+    out << " RL:" << rl;
+    out << " LK:" << lk;
+    out << " VF:" << vf << ")"                                << Col::Reset << " ";
+    out << Col::Magenta << "Retry:" << retry                  << Col::Reset << " ";
+    out << "Rem:" << rem << Col::Reset;
+    asyncLog.push(AsyncLog::Sink::Console, nullptr, out.str());
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -206,6 +677,16 @@ static bool folderHasFiles(const fs::path& p) {
     return false;
 }
 
+static std::uintmax_t folderSize(const fs::path& p) {
+    std::uintmax_t total = 0;
+    try {
+        if (!fs::exists(p)) return 0;
+        for (auto& e : fs::recursive_directory_iterator(p))
+            if (fs::is_regular_file(e)) total += fs::file_size(e);
+    } catch (...) {}
+    return total;
+}
+
 // Wipe the steamcmd staging / downloads folder inside an instance dir.
 // This removes stale .patch and partial download files that cause
 // "Staged file validation failed (N missing)" errors on repeated runs.
@@ -229,6 +710,14 @@ static void cleanStagingFolder(const std::string& instanceDir) {
     }
 }
 
+// Wipe the staged files of one item so its retry starts from scratch.
+static void cleanItemStaging(const std::string& instanceDir, SkinId skinId) {
+    for (const char* sub : { "steamapps/workshop/downloads", "steamapps/workshop/temp" }) {
+        fs::path p = fs::path(instanceDir) / sub / APP_ID / idStr(skinId);
+        try { fs::remove_all(p); } catch (...) {}
+    }
+}
+
 // Wipe stale .patch and .lock files from the shared workshop downloads dir.
 // These are leftover locks that block parallel instances from acquiring access.
 static void cleanSharedPatchFiles() {
@@ -256,456 +745,2637 @@ static void prepareDirs() {
 
 // Move a downloaded skin from the instance's content dir to the shared one.
 // Returns true if skin is confirmed present in shared dir after the operation.
-static bool moveSkinToShared(const std::string& instanceDir, const std::string& skinId) {
+static bool moveSkinToShared(const std::string& instanceDir, SkinId id) {
+    std::string skinId = idStr(id);
     fs::path src = fs::path(instanceDir) / "steamapps" / "workshop" / "content" / APP_ID / skinId;
     fs::path dst = fs::path(CONTENT_PATH) / skinId;
 
-    if (folderHasFiles(dst)) return true; // already present from a previous pass
+    if (presentSkins.has(id)) return true; // already present from an earlier attempt
 
-    if (!folderHasFiles(src)) return false;
+    // Nothing to move: another move may already have put it there.
+    if (!folderHasFiles(src)) return presentSkins.rescan(skinId);
 
     try {
         fs::create_directories(dst.parent_path());
         fs::rename(src, dst); // atomic on same filesystem
-        return folderHasFiles(dst);
     } catch (...) {
         // Cross-device: fall back to recursive copy then remove source
         try {
             fs::copy(src, dst, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
             fs::remove_all(src);
-            return folderHasFiles(dst);
         } catch (const std::exception& ex) {
             fileLog("ERROR moving skin " + skinId + ": " + ex.what());
             return false;
         }
     }
+    return presentSkins.rescan(skinId); // verifies dst and records it in the index
+}
+
+// Open the shared skin index and bring it up to date: one listing of
+// CONTENT_PATH, then only folders that are new or changed since the last run
+// are walked, spread over a few threads.
+static void buildContentIndex() {
+    auto t0 = Clock::now();
+    presentSkins.open();
+    std::vector<std::string> names;
+    try {
+        names = presentSkins.reconcile();
+    } catch (const std::exception& ex) {
+        logMain("WARN: Could not list " + CONTENT_PATH + " (" + ex.what()
+                + ") – using the skin index as it was.", Col::Yellow);
+    }
+
+    unsigned hw      = std::thread::hardware_concurrency();
+    size_t   threads = std::min<size_t>(std::max(1u, std::min(hw, 16u)), names.size());
+    std::vector<std::thread> pool;
+    std::atomic<size_t> next(0);
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([&] {
+            for (size_t i; (i = next.fetch_add(1)) < names.size(); )
+                presentSkins.rescan(names[i]);
+        });
+    }
+    for (auto& t : pool) t.join();
+
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    fileLog("Indexed " + std::to_string(presentSkins.size()) + " existing skin(s), "
+            + std::to_string(names.size()) + " folder(s) rescanned, in " + std::to_string(ms) + "ms"
+            + (presentSkins.persistent() ? "" : " (index file not writable or in use, kept in memory)"));
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  STEAMCMD LOG PARSER
+//  PROCESS BACKEND
 //
-//  Handles all result line formats seen in practice:
-//    [AppID 252490] Download item 3511955902 result : Locking Failed
-//    [AppID 252490] Download item 492051023  result : Failure
-//    [AppID 252490] Update canceled: Staged file validation failed (13 missing...)
-//    [AppID 252490] Update canceled: Failed to write patch state file (File locked)
-//    Success. Downloaded item 1234567 to ...
-//    ERROR! Download item 1234567 failed (Timeout).
-//    Timeout downloading item 1234567
-// ─────────────────────────────────────────────────────────────────────────────
-struct ParsedLog {
-    std::unordered_map<std::string, SkinResult> perItem;
-    bool globalRateLimit      = false;
-    bool globalTimeout        = false;
-    bool globalLockFailed     = false;
-    bool globalValidationFail = false;
-    int  successCount         = 0;
-    int  failureCount         = 0;
+//  steamcmd is started without a shell in between, with stdout+stderr on a
+//  pipe that the supervisor drains, and in its own kill scope so a timeout
+//  takes down exactly one instance:
+//    Linux   – posix_spawn of steamcmd.sh as leader of a new process group.
+//              steamcmd.sh forks the real binary instead of exec'ing it, so
+//              signals go to the whole group (-pid). A pidfd reports exit to
+//              epoll; kernels older than 5.3 fall back to waitpid(WNOHANG).
+//    Windows – CreateProcess into a per-instance job object.
+// ─────────────────────────────────────────────────────────────────────────────
+struct ChildProc {
+#ifdef _WIN32
+    HANDLE process  = nullptr;
+    HANDLE job      = nullptr;   // steamcmd.exe and everything it starts
+    HANDLE outRead  = nullptr;
+    HANDLE inWrite  = nullptr;   // only for children spawned with stdin
+    DWORD  exitCode = 0;
+    double cpuSec   = 0;         // valid once reaped
+#else
+    pid_t         pid    = -1;
+    int           pidfd  = -1;   // -1 when pidfd_open is unavailable
+    int           outFd  = -1;   // read end of the stdout/stderr pipe
+    int           inFd   = -1;   // write end of the stdin pipe, if requested
+    int           status = 0;    // raw wait status, valid once reaped
+    struct rusage usage{};       // child + waited-for descendants, valid once reaped
+#endif
+    bool          reaped = false;
 };
 
-static ParsedLog parseSteamCmdLog(const std::string& logPath,
-                                  const std::vector<std::string>& chunk) {
-    ParsedLog result;
-    std::ifstream file(logPath);
-    if (!file.is_open()) {
-        fileLog("WARN: Could not open log for parsing: " + logPath);
-        return result;
-    }
-
-    for (const auto& id : chunk)
-        result.perItem[id] = SkinResult::Unknown;
-
-    // Workshop log "result :" line
-    std::regex reResult    (R"(\[AppID \d+\] Download item (\d+) result : (.+))");
-    // steamcmd console "Success." line
-    std::regex reSuccess   (R"(Success\. Downloaded item (\d+))");
-    // steamcmd console "ERROR!" line
-    std::regex reError     (R"(ERROR! Download item (\d+) failed \(([^)]+)\))");
-    // steamcmd "Timeout" standalone line
-    std::regex reTimeout   (R"(Timeout downloading item (\d+))");
-    // Staged validation failure with an item ID embedded
-    std::regex reValidation(R"(Staged file validation failed.*?item (\d+))", std::regex::icase);
-    // Patch-state file lock (no item ID in line)
-    std::regex rePatchLock (R"(Failed to write patch state file \(File locked\))", std::regex::icase);
-    // Rate limit
-    std::regex reRateLimit (R"(rate.?limit|too many requests|throttled)", std::regex::icase);
-
-    std::string line;
-    std::string lastId; // context for lines that have no embedded item ID
-
-    while (std::getline(file, line)) {
-        std::smatch m;
-
-        // ── Workshop log result line ─────────────────────────────────────
-        if (std::regex_search(line, m, reResult)) {
-            std::string id     = m[1].str();
-            std::string reason = m[2].str();
-            lastId = id;
-
-            SkinResult sr = SkinResult::Error;
-            if (reason == "OK" || reason.find("Success") != std::string::npos) {
-                sr = SkinResult::Success;
-                result.successCount++;
-            } else if (reason.find("Locking Failed") != std::string::npos ||
-                       reason.find("locked")         != std::string::npos) {
-                sr = SkinResult::LockFailed;
-                result.globalLockFailed = true;
-                result.failureCount++;
-            } else if (reason.find("Timeout") != std::string::npos) {
-                sr = SkinResult::Timeout;
-                result.globalTimeout = true;
-                result.failureCount++;
-            } else if (reason.find("rate") != std::string::npos ||
-                       reason.find("Rate") != std::string::npos) {
-                sr = SkinResult::RateLimit;
-                result.globalRateLimit = true;
-                result.failureCount++;
-            } else {
-                // Generic "Failure" – may be refined by earlier/later context lines
-                sr = SkinResult::Error;
-                result.failureCount++;
-            }
-            if (result.perItem.count(id))
-                result.perItem[id] = sr;
-            continue;
-        }
-
-        // ── Staged file validation failure (with item ID) ────────────────
-        if (std::regex_search(line, m, reValidation)) {
-            std::string id = m[1].str();
-            if (result.perItem.count(id))
-                result.perItem[id] = SkinResult::ValidationFailed;
-            result.globalValidationFail = true;
-            continue;
-        }
-        // Staged file validation failure (no item ID – use lastId context)
-        if (line.find("Staged file validation failed") != std::string::npos ||
-            line.find("Missing update files")          != std::string::npos) {
-            result.globalValidationFail = true;
-            if (!lastId.empty() && result.perItem.count(lastId) &&
-                (result.perItem[lastId] == SkinResult::Error ||
-                 result.perItem[lastId] == SkinResult::Unknown))
-                result.perItem[lastId] = SkinResult::ValidationFailed;
-            continue;
-        }
+#ifdef _WIN32
+static std::string quoteArg(const std::string& a) {
+    if (!a.empty() && a.find_first_of(" \t\"") == std::string::npos) return a;
+    std::string q = "\"";
+    for (char c : a) { if (c == '"') q += '\\'; q += c; }
+    return q + "\"";
+}
 
-        // ── Patch-state lock (no item ID – use lastId context) ───────────
-        if (std::regex_search(line, rePatchLock)) {
-            result.globalLockFailed = true;
-            if (!lastId.empty() && result.perItem.count(lastId) &&
-                (result.perItem[lastId] == SkinResult::Error ||
-                 result.perItem[lastId] == SkinResult::Unknown))
-                result.perItem[lastId] = SkinResult::LockFailed;
-            continue;
-        }
+static bool spawnChild(const std::vector<std::string>& args, ChildProc& child,
+                       bool withStdin = false) {
+    SECURITY_ATTRIBUTES sa{ sizeof(sa), nullptr, TRUE };
+    HANDLE outRd = nullptr, outWr = nullptr;
+    if (!CreatePipe(&outRd, &outWr, &sa, 0)) {
+        fileLog("ERROR: CreatePipe failed: " + std::to_string(GetLastError()));
+        return false;
+    }
+    SetHandleInformation(outRd, HANDLE_FLAG_INHERIT, 0);
+    HANDLE inRd = nullptr, inWr = nullptr;
+    if (withStdin && CreatePipe(&inRd, &inWr, &sa, 0)) {
+        SetHandleInformation(inWr, HANDLE_FLAG_INHERIT, 0);
+    }
+    HANDLE nul = inRd ? INVALID_HANDLE_VALUE
+                      : CreateFileA("NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                    &sa, OPEN_EXISTING, 0, nullptr);
+
+    STARTUPINFOA si{};
+    si.cb         = sizeof(si);
+    si.dwFlags    = STARTF_USESTDHANDLES;
+    si.hStdInput  = inRd ? inRd : nul;
+    si.hStdOutput = outWr;
+    si.hStdError  = outWr;
+
+    std::string cmdLine;
+    for (const auto& a : args) cmdLine += (cmdLine.empty() ? "" : " ") + quoteArg(a);
+
+    PROCESS_INFORMATION pi{};
+    BOOL ok = CreateProcessA(nullptr, &cmdLine[0], nullptr, nullptr, TRUE,
+                             CREATE_SUSPENDED | CREATE_NO_WINDOW,
+                             nullptr, nullptr, &si, &pi);
+    CloseHandle(outWr);
+    if (inRd) CloseHandle(inRd);
+    if (nul != INVALID_HANDLE_VALUE) CloseHandle(nul);
+    if (!ok) {
+        fileLog("ERROR: CreateProcess " + args[0] + " failed: " + std::to_string(GetLastError()));
+        CloseHandle(outRd);
+        if (inWr) CloseHandle(inWr);
+        return false;
+    }
 
-        // ── steamcmd "Success." console line ────────────────────────────
-        if (std::regex_search(line, m, reSuccess)) {
-            std::string id = m[1].str();
-            if (result.perItem.count(id)) {
-                result.perItem[id] = SkinResult::Success;
-                result.successCount++;
-            }
-            lastId = id;
-            continue;
-        }
+    // Kill-on-close also takes the instance down if the downloader itself dies.
+    HANDLE job = CreateJobObjectA(nullptr, nullptr);
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION li{};
+    li.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+    SetInformationJobObject(job, JobObjectExtendedLimitInformation, &li, sizeof(li));
+    AssignProcessToJobObject(job, pi.hProcess);
+    ResumeThread(pi.hThread);
+    CloseHandle(pi.hThread);
+
+    child = ChildProc{};
+    child.process = pi.hProcess;
+    child.job     = job;
+    child.outRead = outRd;
+    child.inWrite = inWr;
+    return true;
+}
 
-        // ── steamcmd "ERROR!" console line ──────────────────────────────
-        if (std::regex_search(line, m, reError)) {
-            std::string id     = m[1].str();
-            std::string reason = m[2].str();
-            lastId = id;
-            SkinResult sr = SkinResult::Error;
-            if (reason.find("Timeout") != std::string::npos) {
-                sr = SkinResult::Timeout;
-                result.globalTimeout = true;
-            } else if (reason.find("rate") != std::string::npos ||
-                       reason.find("Rate") != std::string::npos) {
-                sr = SkinResult::RateLimit;
-                result.globalRateLimit = true;
-            }
-            if (result.perItem.count(id)) result.perItem[id] = sr;
-            result.failureCount++;
-            continue;
-        }
+static bool writeChildInput(ChildProc& child, const std::string& text) {
+    if (!child.inWrite) return false;
+    DWORD n = 0;
+    return WriteFile(child.inWrite, text.data(), (DWORD)text.size(), &n, nullptr)
+        && n == text.size();
+}
 
-        // ── steamcmd "Timeout" standalone console line ───────────────────
-        if (std::regex_search(line, m, reTimeout)) {
-            std::string id = m[1].str();
-            if (result.perItem.count(id)) result.perItem[id] = SkinResult::Timeout;
-            result.globalTimeout = true;
-            result.failureCount++;
-            lastId = id;
-            continue;
-        }
+// EOF on the child's stdin.
+static void closeChildInput(ChildProc& child) {
+    if (child.inWrite) { CloseHandle(child.inWrite); child.inWrite = nullptr; }
+}
 
-        // ── Global rate-limit marker ─────────────────────────────────────
-        if (std::regex_search(line, reRateLimit))
-            result.globalRateLimit = true;
+// Blocks until the process has exited; called from its pipe reader thread.
+static void reapChild(ChildProc& child) {
+    WaitForSingleObject(child.process, INFINITE);
+    GetExitCodeProcess(child.process, &child.exitCode);
+    FILETIME created, exited, kernel, user;
+    if (GetProcessTimes(child.process, &created, &exited, &kernel, &user)) {
+        auto ticks = [](const FILETIME& f) {
+            return ((unsigned long long)f.dwHighDateTime << 32) | f.dwLowDateTime;
+        };
+        child.cpuSec = (ticks(kernel) + ticks(user)) / 1e7;
     }
+    child.reaped = true;
+}
 
-    return result;
+static void terminateChild(ChildProc& child) {
+    if (child.job) TerminateJobObject(child.job, 1);
 }
 
-// ─────────────────────────────────────────────────────────────────────────────
-//  WORKER – one steamcmd instance in its own isolated install directory
-// ─────────────────────────────────────────────────────────────────────────────
-static void workerInstance(const std::vector<std::string>& chunk,
-                            int  threadId,
-                            int  total,
-                            int  pass) {
-    if (chunk.empty()) return;
+static void forceKillChild(ChildProc& child) { terminateChild(child); }
 
-    std::string instanceDir = INST_DIR_PREFIX + std::to_string(threadId);
-    std::string threadTemp  = TEMP_DIR + "/t" + std::to_string(threadId);
-    try {
-        fs::create_directories(threadTemp);
-        fs::create_directories(instanceDir);
-    } catch (...) {}
+static void closeChild(ChildProc& child) {
+    closeChildInput(child);
+    if (child.outRead) { CloseHandle(child.outRead); child.outRead = nullptr; }
+    if (child.process) { CloseHandle(child.process); child.process = nullptr; }
+    if (child.job)     { CloseHandle(child.job);     child.job     = nullptr; }
+}
+
+static std::string describeExit(const ChildProc& child) {
+    std::ostringstream o;
+    o << "exit=" << child.exitCode
+      << " cpu=" << std::fixed << std::setprecision(1) << child.cpuSec << "s";
+    return o.str();
+}
+#else
+static int pidfdOpen(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
 
-    std::string scriptPath = threadTemp + "/script.txt";
-    std::string logPath    = LOG_DIR + "/instance_p" + std::to_string(pass)
-                           + "_t" + std::to_string(threadId) + ".log";
+// Spawn `args` with stdout+stderr on a non-blocking pipe and stdin either on
+// a pipe we write commands into (withStdin) or on /dev/null.
+static bool spawnChild(const std::vector<std::string>& args, ChildProc& child,
+                       bool withStdin = false) {
+    int outPipe[2];
+    if (pipe2(outPipe, O_CLOEXEC) != 0) {
+        fileLog(std::string("ERROR: pipe2 failed: ") + std::strerror(errno));
+        return false;
+    }
+    int inPipe[2] = { -1, -1 };
+    if (withStdin && pipe2(inPipe, O_CLOEXEC) != 0) {
+        fileLog(std::string("ERROR: pipe2 failed: ") + std::strerror(errno));
+        close(outPipe[0]);
+        close(outPipe[1]);
+        return false;
+    }
 
-    // Clean stale staging files in THIS instance's dir before starting
-    cleanStagingFolder(instanceDir);
+    std::vector<char*> argv;
+    for (const auto& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t          attr;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawnattr_init(&attr);
+
+    if (withStdin)
+        posix_spawn_file_actions_adddup2(&fa, inPipe[0], STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, outPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, outPipe[1], STDERR_FILENO);
+
+    // New process group (pgid == pid) and default signal dispositions.
+    sigset_t noSignals, allSignals;
+    sigemptyset(&noSignals);
+    sigfillset(&allSignals);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setsigmask(&attr, &noSignals);
+    posix_spawnattr_setsigdefault(&attr, &allSignals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP |
+                                    POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid = -1;
+    int rc = posix_spawn(&pid, argv[0], &fa, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+    close(outPipe[1]);
+    if (withStdin) close(inPipe[0]);
+
+    if (rc != 0) {
+        fileLog("ERROR: posix_spawn " + args[0] + " failed: " + std::strerror(rc));
+        close(outPipe[0]);
+        if (withStdin) close(inPipe[1]);
+        return false;
+    }
+    fcntl(outPipe[0], F_SETFL, fcntl(outPipe[0], F_GETFL) | O_NONBLOCK);
+
+    child = ChildProc{};
+    child.pid   = pid;
+    child.pidfd = pidfdOpen(pid);
+    child.outFd = outPipe[0];
+    child.inFd  = inPipe[1];
+    return true;
+}
 
-    // ── Write steamcmd script ─────────────────────────────────────────────
-    {
-        std::ofstream sc(scriptPath);
-        if (!sc.is_open()) {
-            logMain("ERROR: Could not create script: " + scriptPath, Col::Red);
-            return;
-        }
-        sc << "login anonymous\n";
-        // Isolated install dir → no shared patch-state-file collisions
-        sc << "force_install_dir ./" << instanceDir << "\n";
-        for (const auto& id : chunk)
-            sc << "workshop_download_item " << APP_ID << " " << id << "\n";
-        sc << "quit\n";
+// Commands are a few dozen bytes, far below the pipe buffer, so a blocking
+// write never stalls. SIGPIPE is ignored (see main) so a dead child is EPIPE.
+static bool writeChildInput(ChildProc& child, const std::string& text) {
+    if (child.inFd < 0) return false;
+    size_t off = 0;
+    while (off < text.size()) {
+        ssize_t n = write(child.inFd, text.data() + off, text.size() - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        off += (size_t)n;
     }
+    return true;
+}
+
+// EOF on the child's stdin.
+static void closeChildInput(ChildProc& child) {
+    if (child.inFd >= 0) { close(child.inFd); child.inFd = -1; }
+}
+
+// Reap the child if it has exited. Blocks only when `block` is set.
+static bool reapChild(ChildProc& child, bool block) {
+    if (child.reaped) return true;
+    int st = 0;
+    pid_t r;
+    do {
+        r = wait4(child.pid, &st, block ? 0 : WNOHANG, &child.usage);
+    } while (r < 0 && errno == EINTR);
+    if (r != child.pid) return false;
+    child.reaped = true;
+    child.status = st;
+    return true;
+}
 
-    fileLog("[T" + std::to_string(threadId) + "][P" + std::to_string(pass) + "] "
-            "Starting | dir=" + instanceDir + " | items=" + std::to_string(chunk.size()));
+static void terminateChild(ChildProc& child) { kill(-child.pid, SIGTERM); }
+static void forceKillChild(ChildProc& child) { kill(-child.pid, SIGKILL); }
 
-    // ── Run steamcmd ──────────────────────────────────────────────────────
-    std::string cmd = "steamcmd.exe +runscript \"" + scriptPath
-                    + "\" > \"" + logPath + "\" 2>&1";
-
-    std::atomic<bool> procDone(false);
-    auto tStart = Clock::now();
-
-    std::thread procThread([&]() {
-        std::system(cmd.c_str());
-        procDone.store(true, std::memory_order_release);
-    });
-
-    long long instanceTimeout = (long long)BASE_TIMEOUT_SEC * (long long)chunk.size();
-    bool timedOut = false;
-
-    while (!procDone.load(std::memory_order_acquire)) {
-        long long elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                                Clock::now() - tStart).count();
-        if (elapsed > instanceTimeout) {
-            timedOut = true;
-            fileLog("[T" + std::to_string(threadId) + "] Hard timeout (" +
-                    std::to_string(elapsed) + "s). Killing steamcmd.");
+static void closeChild(ChildProc& child) {
+    closeChildInput(child);
+    if (child.pidfd >= 0) { close(child.pidfd); child.pidfd = -1; }
+    if (child.outFd >= 0) { close(child.outFd); child.outFd = -1; }
+}
+
+static std::string describeExit(const ChildProc& child) {
+    std::ostringstream o;
+    if (WIFEXITED(child.status))        o << "exit=" << WEXITSTATUS(child.status);
+    else if (WIFSIGNALED(child.status)) o << "signal=" << WTERMSIG(child.status);
+    else                                o << "status=" << child.status;
+    double cpu = child.usage.ru_utime.tv_sec + child.usage.ru_utime.tv_usec / 1e6
+               + child.usage.ru_stime.tv_sec + child.usage.ru_stime.tv_usec / 1e6;
+    o << " cpu=" << std::fixed << std::setprecision(1) << cpu << "s"
+      << " maxrss=" << child.usage.ru_maxrss / 1024 << "MB";
+    return o.str();
+}
+#endif
+
+// Reaped with exit code 0.
+static bool exitedCleanly(const ChildProc& child) {
 #ifdef _WIN32
-            std::system("taskkill /F /IM steamcmd.exe >NUL 2>&1");
+    return child.reaped && child.exitCode == 0;
 #else
-            std::system("pkill -f steamcmd");
+    return child.reaped && WIFEXITED(child.status) && WEXITSTATUS(child.status) == 0;
 #endif
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(STATUS_POLL_MS));
-    }
-
-    procThread.join();
-    long long dur = std::chrono::duration_cast<std::chrono::seconds>(
-                        Clock::now() - tStart).count();
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    try { fs::remove(scriptPath); } catch (...) {}
+}
 
-    // ── Parse log ─────────────────────────────────────────────────────────
-    ParsedLog parsed = parseSteamCmdLog(logPath, chunk);
+// ─────────────────────────────────────────────────────────────────────────────
+//  EVENT LOOP
+//
+//  Delivers child output and exits to the single supervisor thread.
+//    Linux   – one epoll set over every child's pidfd and output pipe.
+//    Windows – a blocking pipe reader per child posts into a queue.
+//  post() lets other threads hand events to the supervisor as well.
+// ─────────────────────────────────────────────────────────────────────────────
+struct LoopEvent {
+    enum class Kind { Output, Exited, ItemReady, Moved } kind = Kind::Output;
+    int         slot = -1;
+    std::string data;            // Output payload / ItemReady directory name
+};
 
-    fileLog("[T" + std::to_string(threadId) + "] Finished in " + std::to_string(dur) + "s"
-            + " | OK="     + std::to_string(parsed.successCount)
-            + " Fail="     + std::to_string(parsed.failureCount)
-            + " RL="       + std::to_string(parsed.globalRateLimit)
-            + " TM="       + std::to_string(parsed.globalTimeout)
-            + " LK="       + std::to_string(parsed.globalLockFailed)
-            + " VF="       + std::to_string(parsed.globalValidationFail));
+class EventLoop {
+public:
+    EventLoop() {
+#ifndef _WIN32
+        epfd   = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        epoll_event ev{};
+        ev.events   = EPOLLIN;
+        ev.data.u64 = TAG_WAKE;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+#endif
+    }
 
-    if (parsed.globalRateLimit) {
-        anyRateLimitDetected.store(true);
-        logMain("[T" + std::to_string(threadId) + "] Rate limit – backing off "
-                + std::to_string(RATELIMIT_BACKOFF_SEC) + "s", Col::Yellow);
-        std::this_thread::sleep_for(std::chrono::seconds(RATELIMIT_BACKOFF_SEC));
+    ~EventLoop() {
+#ifdef _WIN32
+        for (auto& kv : readers)
+            if (kv.second.joinable()) kv.second.join();
+#else
+        if (inotifyFd >= 0) close(inotifyFd);
+        if (wakeFd    >= 0) close(wakeFd);
+        if (epfd      >= 0) close(epfd);
+#endif
     }
 
-    // ── Reconcile: move from instance dir → shared, then classify ─────────
-    for (const auto& id : chunk) {
-        SkinResult sr = parsed.perItem.count(id) ? parsed.perItem.at(id)
-                                                 : SkinResult::Unknown;
+    EventLoop(const EventLoop&)            = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
 
-        bool moved    = moveSkinToShared(instanceDir, id);
-        bool inShared = folderHasFiles(fs::path(CONTENT_PATH) / id);
+    // Start delivering Output / Exited events for `child` under `slot`.
+    void watch(int slot, ChildProc& child) {
+#ifdef _WIN32
+        readers[slot] = std::thread([this, slot, &child]() {
+            char buf[16384];
+            DWORD n = 0;
+            while (ReadFile(child.outRead, buf, sizeof(buf), &n, nullptr) && n > 0)
+                post({ LoopEvent::Kind::Output, slot, std::string(buf, n) });
+            reapChild(child);
+            post({ LoopEvent::Kind::Exited, slot, {} });
+        });
+#else
+        children[slot] = &child;
+        epoll_event ev{};
+        ev.events   = EPOLLIN;
+        ev.data.u64 = ((uint64_t)slot << 2) | TAG_OUTPUT;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, child.outFd, &ev);
+        if (child.pidfd >= 0) {
+            ev.data.u64 = ((uint64_t)slot << 2) | TAG_EXIT;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, child.pidfd, &ev);
+        }
+#endif
+    }
 
-        if (moved || inShared) {
-            sr = SkinResult::Success;
-        } else if (sr == SkinResult::Success) {
-            // steamcmd reported success but no files materialised
-            sr = SkinResult::ValidationFailed;
-            fileLog("WARN: steamcmd said Success for " + id + " but no files found – "
-                    "treating as ValidationFailed (will retry).");
+    // Deliver an ItemReady event for `slot` whenever a directory is renamed
+    // into `dir` – steamcmd's last step for a finished workshop item.
+    // Linux only; returns false where unsupported.
+    bool watchDir(int slot, const std::string& dir) {
+#ifdef _WIN32
+        (void)slot; (void)dir;
+        return false;
+#else
+        if (inotifyFd < 0) {
+            inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (inotifyFd < 0) return false;
+            epoll_event ev{};
+            ev.events   = EPOLLIN;
+            ev.data.u64 = TAG_DIR;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, inotifyFd, &ev);
         }
+        int wd = inotify_add_watch(inotifyFd, dir.c_str(), IN_MOVED_TO | IN_ONLYDIR);
+        if (wd < 0) return false;
+        dirWatches[wd] = slot;
+        return true;
+#endif
+    }
 
-        // Hard-timeout overrides anything that isn't already a success
-        if (timedOut && sr != SkinResult::Success)
-            sr = SkinResult::Timeout;
+    // Stop watching; call once the Exited event for `slot` has been handled.
+    void unwatch(int slot) {
+#ifdef _WIN32
+        auto it = readers.find(slot);
+        if (it == readers.end()) return;
+        if (it->second.joinable()) it->second.join();
+        readers.erase(it);
+#else
+        auto it = children.find(slot);
+        if (it == children.end()) return;
+        if (it->second->outFd >= 0) epoll_ctl(epfd, EPOLL_CTL_DEL, it->second->outFd, nullptr);
+        if (it->second->pidfd >= 0) epoll_ctl(epfd, EPOLL_CTL_DEL, it->second->pidfd, nullptr);
+        children.erase(it);
+#endif
+    }
 
-        switch (sr) {
-            case SkinResult::Success:
-                successCount++;
-                break;
-            case SkinResult::Timeout:
-                timeoutCount++;        failedCount++; break;
-            case SkinResult::RateLimit:
-                ratelimitCount++;      failedCount++; break;
-            case SkinResult::LockFailed:
-                lockFailCount++;       failedCount++; break;
-            case SkinResult::ValidationFailed:
-                validationFailCount++; failedCount++; break;
-            default:
-                errorCount++;          failedCount++; sr = SkinResult::Error; break;
-        }
-        totalProcessed++;
+    // Wake the supervisor with no event. Safe from a signal handler (Linux)
+    // or a console control handler (Windows).
+    void wake() {
+#ifdef _WIN32
+        {
+            std::lock_guard<std::mutex> lk(postMtx);
+            wakeRequested = true;
+        }
+        postCv.notify_one();
+#else
+        uint64_t one = 1;
+        ssize_t w = write(wakeFd, &one, sizeof(one));
+        (void)w;
+#endif
+    }
 
+    // Thread-safe: queue an event for the supervisor and wake it.
+    void post(LoopEvent ev) {
         {
-            std::lock_guard<std::mutex> lk(resultMtx);
-            skinResults[id] = sr;
+            std::lock_guard<std::mutex> lk(postMtx);
+            posted.push_back(std::move(ev));
         }
+#ifdef _WIN32
+        postCv.notify_one();
+#else
+        uint64_t one = 1;
+        ssize_t w = write(wakeFd, &one, sizeof(one));
+        (void)w;
+#endif
     }
 
-    // Clean staging again so the next pass on this instance dir starts fresh
-    cleanStagingFolder(instanceDir);
-}
+    // Wait up to timeoutMs and append whatever happened to `out`.
+    void wait(int timeoutMs, std::vector<LoopEvent>& out) {
+        out.clear();
+#ifdef _WIN32
+        std::unique_lock<std::mutex> lk(postMtx);
+        postCv.wait_for(lk, std::chrono::milliseconds(std::max(0, timeoutMs)),
+                        [this] { return !posted.empty() || wakeRequested; });
+        wakeRequested = false;
+#else
+        // Without pidfds nothing tells epoll about an exit; fall back to polling.
+        bool pollExits = false;
+        for (auto& kv : children) if (kv.second->pidfd < 0) pollExits = true;
+        if (pollExits) timeoutMs = std::min(timeoutMs, 100);
+
+        epoll_event evs[64];
+        int n = epoll_wait(epfd, evs, 64, std::max(0, timeoutMs));
+        for (int i = 0; i < n; ++i) {
+            uint64_t tag  = evs[i].data.u64 & 3;
+            int      slot = (int)(evs[i].data.u64 >> 2);
+            if (tag == TAG_WAKE) {
+                uint64_t v;
+                ssize_t r = read(wakeFd, &v, sizeof(v));
+                (void)r;
+                continue;
+            }
+            if (tag == TAG_DIR) {
+                drainDirEvents(out);
+                continue;
+            }
+            auto it = children.find(slot);
+            if (it == children.end()) continue;
+            ChildProc& child = *it->second;
+            if (tag == TAG_OUTPUT) {
+                drainOutput(slot, child, out);
+            } else if (!child.reaped && reapChild(child, false)) {
+                drainOutput(slot, child, out); // whatever was written before exit
+                out.push_back({ LoopEvent::Kind::Exited, slot, {} });
+            }
+        }
+        if (pollExits) {
+            for (auto& kv : children) {
+                ChildProc& child = *kv.second;
+                if (child.pidfd >= 0 || child.reaped || !reapChild(child, false)) continue;
+                drainOutput(kv.first, child, out);
+                out.push_back({ LoopEvent::Kind::Exited, kv.first, {} });
+            }
+        }
+        std::lock_guard<std::mutex> lk(postMtx);
+#endif
+        for (auto& ev : posted) out.push_back(std::move(ev));
+        posted.clear();
+    }
 
-// ─────────────────────────────────────────────────────────────────────────────
-//  JSON ID PARSER
-// ─────────────────────────────────────────────────────────────────────────────
-static std::vector<std::string> parseIds(const std::string& jsonFile) {
-    std::ifstream file(jsonFile);
-    std::vector<std::string> result;
-    std::string line;
-    std::regex idRe(R"re("(\d{6,12})")re");
+private:
+    std::mutex             postMtx;
+    std::deque<LoopEvent>  posted;
+#ifdef _WIN32
+    std::condition_variable               postCv;
+    bool                                  wakeRequested = false;
+    std::unordered_map<int, std::thread>  readers;
+#else
+    static constexpr uint64_t TAG_OUTPUT = 0, TAG_EXIT = 1, TAG_WAKE = 2, TAG_DIR = 3;
+    int                                   epfd      = -1;
+    int                                   wakeFd    = -1;
+    int                                   inotifyFd = -1;
+    std::unordered_map<int, ChildProc*>   children;
+    std::unordered_map<int, int>          dirWatches; // inotify wd -> slot
+
+    void drainDirEvents(std::vector<LoopEvent>& out) {
+        alignas(inotify_event) char buf[8192];
+        for (;;) {
+            ssize_t n = read(inotifyFd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            for (ssize_t off = 0; off < n; ) {
+                auto* ie = reinterpret_cast<inotify_event*>(buf + off);
+                off += (ssize_t)(sizeof(inotify_event) + ie->len);
+                auto it = dirWatches.find(ie->wd);
+                if (it == dirWatches.end() || !(ie->mask & IN_ISDIR) || ie->len == 0) continue;
+                out.push_back({ LoopEvent::Kind::ItemReady, it->second, std::string(ie->name) });
+            }
+        }
+    }
 
-    while (std::getline(file, line)) {
-        std::smatch m;
-        std::string s = line;
-        while (std::regex_search(s, m, idRe)) {
-            result.push_back(m[1]);
-            s = m.suffix().str();
+    void drainOutput(int slot, ChildProc& child, std::vector<LoopEvent>& out) {
+        if (child.outFd < 0) return;
+        char buf[16384];
+        for (;;) {
+            ssize_t n = read(child.outFd, buf, sizeof(buf));
+            if (n > 0) {
+                out.push_back({ LoopEvent::Kind::Output, slot, std::string(buf, (size_t)n) });
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0) {
+                // EOF: stop watching the pipe, the pidfd still reports the exit.
+                epoll_ctl(epfd, EPOLL_CTL_DEL, child.outFd, nullptr);
+                close(child.outFd);
+                child.outFd = -1;
+            }
+            return;
         }
     }
-    std::unordered_set<std::string> seen;
-    result.erase(std::remove_if(result.begin(), result.end(),
-        [&](const std::string& id){ return !seen.insert(id).second; }), result.end());
-    return result;
-}
+#endif
+};
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  PARTITIONER
+//  STOP SIGNALS
+//
+//  The handler only counts and wakes the supervisor; runDownloads() does the
+//  drain (bootstrapTemplate() kills its steamcmd). Installed before the first
+//  steamcmd starts: children run in their own process group, so a terminal
+//  Ctrl+C reaches only us. With no loop running (report writing) a second
+//  signal exits straight from the handler.
 // ─────────────────────────────────────────────────────────────────────────────
-static std::vector<std::vector<std::string>> partition(const std::vector<std::string>& ids,
-                                                        int n) {
-    std::vector<std::vector<std::string>> chunks(n);
-    int base = (int)ids.size() / n;
-    int rem  = (int)ids.size() % n;
-    int idx  = 0;
-    for (int i = 0; i < n; ++i) {
-        int sz = base + (i < rem ? 1 : 0);
-        for (int j = 0; j < sz && idx < (int)ids.size(); ++j)
-            chunks[i].push_back(ids[idx++]);
-    }
-    return chunks;
+std::atomic<int>        stopSignals(0);
+std::atomic<EventLoop*> stopLoop(nullptr);  // set while runDownloads() / bootstrapTemplate() wait
+
+#ifdef _WIN32
+static BOOL WINAPI onStopSignal(DWORD type) {
+    if (type != CTRL_C_EVENT && type != CTRL_BREAK_EVENT && type != CTRL_CLOSE_EVENT) return FALSE;
+    int        n    = ++stopSignals;
+    EventLoop* loop = stopLoop.load();
+    if (n >= 2 && !loop) ExitProcess(130);
+    if (loop) loop->wake();
+    return TRUE;
+}
+#else
+static void onStopSignal(int) {
+    int        n    = ++stopSignals;
+    EventLoop* loop = stopLoop.load();
+    if (n >= 2 && !loop) _exit(130);
+    if (loop) loop->wake();
+}
+#endif
+
+static void installStopHandlers() {
+#ifdef _WIN32
+    SetConsoleCtrlHandler(onStopSignal, TRUE);
+#else
+    struct sigaction sa{};
+    sa.sa_handler = onStopSignal;
+    sa.sa_flags   = SA_RESTART;     // the eventfd wakes the loop; nothing else should see EINTR
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT,  &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+#endif
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  RUN ONE PASS
+//  MOVER POOL
+//
+//  Moving a finished skin to the shared dir and checking it arrived is disk
+//  I/O that must not hold up the supervisor. Jobs go through a bounded queue
+//  to MOVER_THREADS workers; each finished job wakes the EventLoop with a
+//  Moved event and the supervisor collects results with takeDone().
+//  Jobs for the same skin never run at once: the reconcile job waits behind
+//  its early (inotify) move and then finds the skin in the index.
 // ─────────────────────────────────────────────────────────────────────────────
-static void runPass(const std::vector<std::string>& toDownload,
-                    int instances, int pass, int grandTotal) {
-    if (toDownload.empty()) return;
+struct MoveJob {
+    int         slot = -1;
+    std::string instanceDir;
+    SkinId      id        = 0;
+    bool        reconcile = true;  // false: early move only, nobody waits for the result
+    SkinResult  parsed    = SkinResult::Unknown;
+    bool        timedOut  = false;
+    bool        interrupted = false; // the slot's run was cut off by a stop request
+    bool        present   = false; // filled in by the worker: skin is in the shared dir
+    Clock::time_point startedAt;   // filled in by the worker: when the move began
+    Clock::time_point doneAt;      // filled in by the worker: when the move finished
+    int         worker    = -1;    // filled in by the worker: its index
+};
 
-    int n = std::min(instances, (int)toDownload.size());
-    auto chunks = partition(toDownload, n);
+class MoverPool {
+public:
+    MoverPool(int threads, EventLoop& loop) : loop(loop) {
+        for (int i = 0; i < threads; ++i)
+            workers.emplace_back([this, i] { run(i); });
+    }
 
-    logMain("Pass " + std::to_string(pass) + "/" + std::to_string(MAX_RETRY_PASSES + 1)
-            + ": " + std::to_string(toDownload.size()) + " skins → "
-            + std::to_string(n) + " isolated steamcmd instance(s).", Col::Cyan);
+    ~MoverPool() {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            stopping = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+        for (auto& t : workers) t.join();
+    }
 
-    cleanSharedPatchFiles(); // remove leftover shared locks before spawning
+    MoverPool(const MoverPool&)            = delete;
+    MoverPool& operator=(const MoverPool&) = delete;
 
-    std::vector<std::thread> pool;
-    pool.reserve(n);
-    for (int i = 0; i < n; ++i)
-        pool.emplace_back(workerInstance, std::cref(chunks[i]), i, grandTotal, pass);
+    // Supervisor: hand off one job; blocks only while MOVER_QUEUE_MAX are pending.
+    void submit(MoveJob job) {
+        std::unique_lock<std::mutex> lk(mtx);
+        notFull.wait(lk, [this] { return stopping || queue.size() < (size_t)MOVER_QUEUE_MAX; });
+        queue.push_back(std::move(job));
+        outstanding++;
+        notEmpty.notify_one();
+    }
 
-    std::atomic<bool> allDone(false);
-    std::thread statusThread([&]() {
-        while (!allDone.load(std::memory_order_acquire)) {
-            printProgress(grandTotal, pass, MAX_RETRY_PASSES + 1);
-            std::this_thread::sleep_for(std::chrono::milliseconds(STATUS_POLL_MS));
-        }
-        printProgress(grandTotal, pass, MAX_RETRY_PASSES + 1);
-    });
+    // Supervisor: finished jobs since the last call.
+    std::vector<MoveJob> takeDone() {
+        std::lock_guard<std::mutex> lk(mtx);
+        std::vector<MoveJob> out;
+        out.swap(done);
+        outstanding -= (int)out.size();
+        return out;
+    }
 
-    for (auto& t : pool) t.join();
-    allDone.store(true);
-    if (statusThread.joinable()) statusThread.join();
-}
+    bool idle() {
+        std::lock_guard<std::mutex> lk(mtx);
+        return outstanding == 0;
+    }
+
+private:
+    EventLoop&               loop;
+    std::vector<std::thread> workers;
+    std::mutex               mtx;
+    std::condition_variable  notEmpty, notFull;
+    std::deque<MoveJob>      queue;
+    std::vector<MoveJob>     done;
+    std::unordered_set<SkinId> moving;        // IDs a worker is on right now
+    int                      outstanding = 0; // submitted, not yet taken back
+    bool                     stopping    = false;
+
+    void run(int index) {
+        for (;;) {
+            MoveJob job;
+            {
+                // Oldest job whose skin no other worker is moving.
+                std::unique_lock<std::mutex> lk(mtx);
+                auto next = queue.end();
+                notEmpty.wait(lk, [&] {
+                    next = std::find_if(queue.begin(), queue.end(),
+                                        [&](const MoveJob& j) { return !moving.count(j.id); });
+                    return next != queue.end() || (stopping && queue.empty());
+                });
+                if (next == queue.end()) return;
+                job = std::move(*next);
+                queue.erase(next);
+                moving.insert(job.id);
+            }
+            notFull.notify_one();
+
+            job.worker    = index;
+            job.startedAt = Clock::now();
+            job.present   = moveSkinToShared(job.instanceDir, job.id);
+            job.doneAt    = Clock::now();
+            int slot = job.slot;
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                moving.erase(job.id);
+                done.push_back(std::move(job));
+            }
+            notEmpty.notify_all();     // a job held back behind this skin may go now
+            loop.post({ LoopEvent::Kind::Moved, slot, {} });
+        }
+    }
+};
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  HELPERS FOR RETRY LOGIC
+//  RESULT JOURNAL
+//
+//  One line per item state change, appended by the supervisor:
+//      D <id> <attempt>            handed to an instance
+//      R <id> <attempt> <result>   failed, will be retried
+//      S <id> <attempt>            succeeded
+//      F <id> <attempt> <result>   failed for good
+//  Lines collect in memory and go to disk with one write + fsync per
+//  JOURNAL_SYNC_MS, so a crash loses at most that much – those items are
+//  simply redone. Replaying keeps the last line per ID; a torn last line is
+//  ignored.
 // ─────────────────────────────────────────────────────────────────────────────
-static std::vector<std::string> collectFailed(const std::vector<std::string>& ids) {
-    std::vector<std::string> out;
+class ResultJournal {
+public:
+    explicit ResultJournal(std::string journalPath) : path(std::move(journalPath)) {}
+    ~ResultJournal() { close(); }
+
+    // `append`: continue a resumed run's journal, otherwise start a new one.
+    bool open(bool append) {
+        bool torn = false;      // an earlier run died mid-line: start on a fresh one
+        if (append) {
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            if (in && in.tellg() > 0) {
+                in.seekg(-1, std::ios::end);
+                torn = in.get() != '\n';
+            }
+        }
+#ifdef _WIN32
+        handle = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr,
+                             append ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return false;
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+        if (fd < 0) return false;
+#endif
+        if (torn) pending += '\n';
+        nextSync = Clock::now();
+        return true;
+    }
+
+    void dispatched(SkinId id, int attempt) { add('D', id, attempt, nullptr); }
+    void retrying(SkinId id, int attempt, SkinResult sr) { add('R', id, attempt, &sr); }
+    void finished(SkinId id, int attempt, SkinResult sr) {
+        if (sr == SkinResult::Success) add('S', id, attempt, nullptr);
+        else                           add('F', id, attempt, &sr);
+    }
+
+    // Write and fsync what has collected, once JOURNAL_SYNC_MS has passed
+    // since the last sync (or right away with `force`).
+    void sync(Clock::time_point now, bool force = false) {
+        if (pending.empty() || (!force && now < nextSync)) return;
+#ifdef _WIN32
+        if (isOpen()) {
+            DWORD written = 0;
+            WriteFile(handle, pending.data(), (DWORD)pending.size(), &written, nullptr);
+            FlushFileBuffers(handle);
+        }
+#else
+        if (isOpen()) {
+            const char* p = pending.data();
+            size_t      n = pending.size();
+            while (n > 0) {
+                ssize_t w = ::write(fd, p, n);
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) break;
+                p += w;
+                n -= (size_t)w;
+            }
+            fdatasync(fd);
+        }
+#endif
+        pending.clear();
+        nextSync = now + std::chrono::milliseconds(JOURNAL_SYNC_MS);
+    }
+
+    // When the next sync is due, or max() if nothing is waiting.
+    Clock::time_point nextDue() const {
+        return pending.empty() ? Clock::time_point::max() : nextSync;
+    }
+
+    void close() {
+        sync(Clock::now(), true);
+#ifdef _WIN32
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        handle = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    // The run finished and its report is on disk: nothing left to resume.
+    void discard() {
+        close();
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+
+private:
+    std::string       path;
+    std::string       pending;
+    Clock::time_point nextSync;
+#ifdef _WIN32
+    HANDLE            handle = INVALID_HANDLE_VALUE;
+#else
+    int               fd     = -1;
+#endif
+
+    bool isOpen() const {
+#ifdef _WIN32
+        return handle != INVALID_HANDLE_VALUE;
+#else
+        return fd >= 0;
+#endif
+    }
+
+    void add(char kind, SkinId id, int attempt, const SkinResult* sr) {
+        if (!isOpen()) return;
+        pending += kind;
+        pending += ' ';
+        pending += idStr(id);
+        pending += ' ';
+        pending += std::to_string(attempt);
+        if (sr) {
+            pending += ' ';
+            pending += resultName(*sr);
+        }
+        pending += '\n';
+    }
+};
+ResultJournal journal(JOURNAL_FILE);
+
+// What a journal left behind, per catalog row.
+struct JournalReplay {
+    std::vector<SkinResult>   results;   // final result, Unknown = still open
+    std::vector<std::uint8_t> attempts;  // failed attempts so far
+    size_t seen = 0, finished = 0;
+};
+
+static JournalReplay readJournal(const std::string& path) {
+    JournalReplay rp;
+    std::ifstream in(path);
+    if (!in) return rp;
+    rp.results.assign(catalog.size(), SkinResult::Unknown);
+    rp.attempts.assign(catalog.size(), 0);
+    std::vector<bool> seen(catalog.size(), false);
+
+    std::string ln;
+    while (std::getline(in, ln)) {
+        std::istringstream ls(ln);
+        char        kind = 0;
+        std::string idText, result;
+        int         attempt = 0;
+        if (!(ls >> kind >> idText >> attempt) || attempt < 1) continue;
+        size_t row = catalog.row(skinindex::parseId(idText));
+        if (row == SkinCatalog::npos) continue;     // not in ImportedSkins.json any more
+        ls >> result;
+        switch (kind) {
+            case 'D': rp.results[row] = SkinResult::Unknown; rp.attempts[row] = (std::uint8_t)(attempt - 1); break;
+            case 'R': rp.results[row] = SkinResult::Unknown; rp.attempts[row] = (std::uint8_t)attempt;       break;
+            case 'S': rp.results[row] = SkinResult::Success; rp.attempts[row] = (std::uint8_t)(attempt - 1); break;
+            case 'F':
+                if (!steamcmdlog::parseResultName(result, rp.results[row]) || rp.results[row] == SkinResult::Unknown)
+                    rp.results[row] = SkinResult::Error;
+                rp.attempts[row] = (std::uint8_t)attempt;
+                break;
+            default:  continue;
+        }
+        if (!seen[row]) { seen[row] = true; rp.seen++; }
+    }
+    for (auto r : rp.results)
+        if (r != SkinResult::Unknown) rp.finished++;
+    return rp;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  EVENT STREAM
+//
+//  With WRITE_EVENT_STREAM every item state change also goes to EVENTS_FILE,
+//  one JSON object per line:
+//      queued      on the work queue; a retry once its backoff is set ("delay_ms")
+//      dispatched  handed to instance "slot"
+//      result      steamcmd settled it ("exit": no result line, the instance ended)
+//      moved       a move attempt finished ("present": skin is in the shared dir,
+//                  "early": moved on rename, before its result line)
+//      verified    the attempt's outcome ("next": done / retry / failed / open)
+//  "t_us" counts steady-clock microseconds from open(), so spans between lines
+//  hold even if the wall clock jumps. Only the supervisor writes.
+// ─────────────────────────────────────────────────────────────────────────────
+class EventStream {
+public:
+    bool open(const std::string& path) {
+        out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        origin = Clock::now();
+        out << "{\"t_us\":0,\"ev\":\"start\",\"clock\":\"" << timestamp() << "\"}\n";
+        return true;
+    }
+
+    void close() { if (out.is_open()) out.close(); }
+    void flush() { if (out.is_open()) out.flush(); }
+
+    void queued(SkinId id, int attempt, long long delayMs = 0) {
+        if (!begin("queued", Clock::now(), id, attempt)) return;
+        if (delayMs > 0) field("delay_ms", std::to_string(delayMs));
+        end();
+    }
+    void dispatched(SkinId id, int attempt, int slot) {
+        if (!begin("dispatched", Clock::now(), id, attempt)) return;
+        field("slot", std::to_string(slot));
+        end();
+    }
+    void result(SkinId id, int attempt, int slot, SkinResult sr, bool atExit) {
+        if (!begin("result", Clock::now(), id, attempt)) return;
+        field("slot", std::to_string(slot));
+        field("result", quoted(resultName(sr)));
+        if (atExit) field("exit", "true");
+        end();
+    }
+    void moved(SkinId id, int attempt, int slot, bool present, bool early, Clock::time_point at) {
+        if (!begin("moved", at, id, attempt)) return;
+        field("slot", std::to_string(slot));
+        field("present", present ? "true" : "false");
+        if (early) field("early", "true");
+        end();
+    }
+    void verified(SkinId id, int attempt, int slot, SkinResult sr, const char* next) {
+        if (!begin("verified", Clock::now(), id, attempt)) return;
+        field("slot", std::to_string(slot));
+        field("result", quoted(resultName(sr)));
+        field("next", quoted(next));
+        end();
+    }
+
+private:
+    std::ofstream     out;
+    Clock::time_point origin;
+    std::string       line;
+
+    static std::string quoted(const std::string& s) { return "\"" + s + "\""; }
+
+    bool begin(const char* ev, Clock::time_point at, SkinId id, int attempt) {
+        if (!out.is_open()) return false;
+        long long us = std::chrono::duration_cast<std::chrono::microseconds>(at - origin).count();
+        line  = "{\"t_us\":";
+        line += std::to_string(us);
+        line += ",\"ev\":\"";
+        line += ev;
+        line += "\",\"id\":";
+        line += idStr(id);
+        line += ",\"attempt\":";
+        line += std::to_string(attempt);
+        return true;
+    }
+    void field(const char* key, const std::string& value) {
+        line += ",\"";
+        line += key;
+        line += "\":";
+        line += value;
+    }
+    void end() {
+        line += "}\n";
+        out.write(line.data(), (std::streamsize)line.size());
+    }
+};
+EventStream eventStream;
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  TIMELINE TRACE
+//
+//  With WRITE_TRACE, TRACE_FILE gets Chrome trace events (JSON array form):
+//    supervisor  moves done inline (MOVER_THREADS = 0), per-item staging cleanup
+//    T<n>        one track per instance slot: batch / session, spawn (until the
+//                first output), login, staging cleanup and one span per item
+//                from the moment steamcmd could start it until its result
+//    mover <n>   one track per mover thread: every move + verify
+//    backoff     retry waits, one async span per item
+//  plus an "instances" counter for the AIMD limit. The array is closed on a
+//  clean exit; trace viewers also load a file that was cut off mid-run.
+//  Only the supervisor writes – mover jobs carry their own timestamps.
+// ─────────────────────────────────────────────────────────────────────────────
+class TraceWriter {
+public:
+    static constexpr int SUPERVISOR_TRACK = 0;
+    static int slotTrack(int slot)    { return 1 + slot; }
+    static int moverTrack(int worker) { return 1000 + worker; }
+
+    bool open(const std::string& path) {
+        out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        origin = Clock::now();
+        first  = true;
+        out << "[\n";
+        meta("process_name", 0, "\"name\":\"downloader\"");
+        nameTrack(SUPERVISOR_TRACK, "supervisor");
+        return true;
+    }
+
+    bool enabled() const { return out.is_open(); }
+
+    void close() {
+        if (!out.is_open()) return;
+        out << "\n]\n";
+        out.close();
+    }
+    void flush() { if (out.is_open()) out.flush(); }
+
+    void nameTrack(int tid, const std::string& name) {
+        if (!out.is_open()) return;
+        meta("thread_name", tid, "\"name\":" + jsonString(name));
+        meta("thread_sort_index", tid, "\"sort_index\":" + std::to_string(tid));
+    }
+
+    // A complete span; `args` is the inside of a JSON object or empty.
+    void span(int tid, const char* cat, const std::string& name,
+              Clock::time_point from, Clock::time_point to, const std::string& args = {}) {
+        if (!out.is_open()) return;
+        if (to < from) to = from;
+        event("{\"ph\":\"X\",\"cat\":\"" + std::string(cat) + "\",\"name\":" + jsonString(name)
+              + ",\"pid\":1,\"tid\":" + std::to_string(tid)
+              + ",\"ts\":" + std::to_string(micros(from))
+              + ",\"dur\":" + std::to_string(micros(to) - micros(from))
+              + (args.empty() ? std::string() : ",\"args\":{" + args + "}") + "}");
+    }
+
+    // An overlapping span keyed by `id` (both ends are known up front).
+    void asyncSpan(const char* cat, const std::string& name, SkinId id,
+                   Clock::time_point from, Clock::time_point to, const std::string& args = {}) {
+        if (!out.is_open()) return;
+        std::string head = "{\"cat\":\"" + std::string(cat) + "\",\"name\":" + jsonString(name)
+                         + ",\"id\":\"" + idStr(id) + "\",\"pid\":1,\"tid\":"
+                         + std::to_string(SUPERVISOR_TRACK);
+        event(head + ",\"ph\":\"b\",\"ts\":" + std::to_string(micros(from))
+              + (args.empty() ? std::string() : ",\"args\":{" + args + "}") + "}");
+        event(head + ",\"ph\":\"e\",\"ts\":" + std::to_string(micros(to)) + "}");
+    }
+
+    void counter(const char* name, Clock::time_point at, long long value) {
+        if (!out.is_open()) return;
+        event(std::string("{\"ph\":\"C\",\"name\":\"") + name + "\",\"pid\":1,\"ts\":"
+              + std::to_string(micros(at)) + ",\"args\":{\"value\":" + std::to_string(value) + "}}");
+    }
+
+    static std::string jsonString(const std::string& s) {
+        std::string o = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') { o += '\\'; o += c; }
+            else if ((unsigned char)c < 0x20) o += ' ';
+            else o += c;
+        }
+        return o + "\"";
+    }
+
+private:
+    std::ofstream     out;
+    Clock::time_point origin;
+    bool              first = true;
+
+    long long micros(Clock::time_point t) const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - origin).count();
+    }
+
+    void meta(const char* name, int tid, const std::string& args) {
+        event(std::string("{\"ph\":\"M\",\"name\":\"") + name + "\",\"pid\":1,\"tid\":"
+              + std::to_string(tid) + ",\"args\":{" + args + "}}");
+    }
+
+    void event(const std::string& e) {
+        if (!first) out << ",\n";
+        first = false;
+        out << e;
+    }
+};
+TraceWriter trace;
+
+static std::string traceArgs(SkinId id, int attempt) {
+    return "\"id\":" + idStr(id) + ",\"attempt\":" + std::to_string(attempt);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  INSTANCE SLOT – one steamcmd instance in its own isolated install directory
+//
+//  Slots are owned and driven by the supervisor loop in runDownloads(); nothing in
+//  here blocks on the child process.
+// ─────────────────────────────────────────────────────────────────────────────
+enum class SlotState {
+    Idle,
+    Running    // steamcmd is alive; output and exit arrive through the EventLoop
+};
+
+struct InstanceSlot {
+    int                      id    = 0;
+    SlotState                state = SlotState::Idle;
+    ChildProc                proc;
+    std::vector<SkinId>      chunk;
+    std::unordered_set<SkinId> released;     // stolen by another slot – results ignored here
+    std::unique_ptr<SteamCmdLogParser> parser;
+    std::string              instanceDir;
+    std::string              scriptPath;
+    std::string              logPath;
+    std::ofstream            log;     // only when WRITE_INSTANCE_LOGS
+    Clock::time_point        started;
+    Clock::time_point        deadline;       // stall check: no progress since deadline - STALL_WINDOW_SEC
+    int                      resultMarks = 0;  // parser result lines seen so far
+    std::uintmax_t           stagedBytes = 0;  // downloads + content size at the last sample
+    Clock::time_point        termSentAt;
+    bool                     timedOut = false;
+    bool                     termSent = false;
+    bool                     killSent = false;
+    bool                     interrupted = false; // killed by a stop request – open items stay open
+    int                      batches  = 0;   // runs started on this slot
+    std::vector<std::pair<SkinId, SkinResult>> retries; // failed, attempts left – for the supervisor
+    std::vector<SkinResult>  outcomes;       // every attempt's result – for the concurrency controller
+    MoverPool*               mover = nullptr; // null = move on the supervisor thread
+
+    // Persistent session state (PERSISTENT_SESSIONS)
+    bool                     session  = false;
+    bool                     quitSent = false;
+    std::deque<SkinId>       inFlight;       // sent, no result line yet; front = downloading
+    int                      rateLimitSeen = 0; // parser rate-limit hits already reported
+    int                      failedStarts  = 0; // sessions in a row that died before a result line
+    Clock::time_point        restartAt;         // no new session before this
+    bool                     givenUp       = false; // SESSION_FAIL_LIMIT reached: never started again
+
+    // Timeline marks (WRITE_TRACE)
+    Clock::time_point        preparedAt;     // run set-up began
+    Clock::time_point        outputAt;       // first output; max() until then
+    Clock::time_point        loginAt;        // login confirmed; max() until then
+    Clock::time_point        itemMark;       // steamcmd could start the next item from here
+};
+
+static std::string slotTag(const InstanceSlot& s) {
+    return "[T" + std::to_string(s.id) + "]";
+}
+
+static void finishInstance(InstanceSlot& slot);
+
+// Bytes steamcmd has staged or unpacked in the instance dir.
+static std::uintmax_t stagedBytes(const InstanceSlot& slot) {
+    return folderSize(fs::path(slot.instanceDir) / "steamapps" / "workshop" / "downloads")
+         + folderSize(fs::path(slot.instanceDir) / "steamapps" / "workshop" / "content" / APP_ID);
+}
+
+static std::string steamcmdExe() {
+#ifdef _WIN32
+    return STEAMCMD_BIN;
+#else
+    return "./" + STEAMCMD_BIN;
+#endif
+}
+
+// Per-run paths and a clean staging area for the slot's instance dir.
+static void prepareInstance(InstanceSlot& slot) {
+    slot.preparedAt = Clock::now();
+    slot.outputAt   = slot.loginAt = Clock::time_point::max();
+    slot.released.clear();
+    slot.timedOut = slot.termSent = slot.killSent = slot.interrupted = false;
+    slot.session  = slot.quitSent = false;
+    slot.inFlight.clear();
+    slot.rateLimitSeen = 0;
+
+    slot.instanceDir = INST_DIR_PREFIX + std::to_string(slot.id);
+    std::string threadTemp = TEMP_DIR + "/t" + std::to_string(slot.id);
+    try {
+        fs::create_directories(threadTemp);
+        fs::create_directories(slot.instanceDir);
+    } catch (...) {}
+
+    slot.scriptPath = threadTemp + "/script.txt";
+    slot.logPath    = LOG_DIR + "/instance_t" + std::to_string(slot.id) + ".log";
+
+    // Clean stale staging files in THIS instance's dir before starting
+    auto cleanFrom = Clock::now();
+    cleanStagingFolder(slot.instanceDir);
+    trace.span(TraceWriter::slotTrack(slot.id), "cleanup", "clean staging", cleanFrom, Clock::now());
+    slot.resultMarks = 0;
+    slot.stagedBytes = stagedBytes(slot);
+}
+
+// One file per slot; later runs on the slot append to it.
+static void openInstanceLog(InstanceSlot& slot, const std::string& header) {
+    if (!WRITE_INSTANCE_LOGS) return;
+    slot.log.open(slot.logPath, std::ios::out | std::ios::binary
+                                | (slot.batches == 0 ? std::ios::trunc : std::ios::app));
+    slot.log << "==== " << header << " ====\n";
+}
+
+static void startInstance(InstanceSlot& slot, std::vector<SkinId> chunk, EventLoop& loop) {
+    if (chunk.empty()) return;
+    prepareInstance(slot);
+    slot.chunk = std::move(chunk);
+    slot.parser.reset(new SteamCmdLogParser(slot.chunk));
+    slot.started  = Clock::now();
+    slot.deadline = slot.started + std::chrono::seconds(STALL_WINDOW_SEC);
+    slot.itemMark = slot.started;
+    for (const auto& id : slot.chunk) {
+        journal.dispatched(id, itemTable.attempts(id) + 1);
+        eventStream.dispatched(id, itemTable.attempts(id) + 1, slot.id);
+    }
+
+    // ── Write steamcmd script ─────────────────────────────────────────────
+    {
+        std::ofstream sc(slot.scriptPath);
+        if (!sc.is_open()) {
+            logMain("ERROR: Could not create script: " + slot.scriptPath, Col::Red);
+            // The items are off the queue: settle them as failed attempts.
+            finishInstance(slot);
+            return;
+        }
+        sc << "login anonymous\n";
+        // Isolated install dir → no shared patch-state-file collisions
+        sc << "force_install_dir ./" << slot.instanceDir << "\n";
+        for (const auto& id : slot.chunk)
+            sc << "workshop_download_item " << APP_ID << " " << id << "\n";
+        sc << "quit\n";
+    }
+
+    fileLog(slotTag(slot) + " Starting | dir=" + slot.instanceDir + " | items=" + std::to_string(slot.chunk.size()));
+
+    // ── Run steamcmd ──────────────────────────────────────────────────────
+    openInstanceLog(slot, "batch " + std::to_string(slot.batches + 1)
+                          + " | items=" + std::to_string(slot.chunk.size()));
+    slot.batches++;
+    if (!spawnChild({ steamcmdExe(), "+runscript", slot.scriptPath }, slot.proc)) {
+        // Nothing ran: with no output every item settles as failed.
+        finishInstance(slot);
+        return;
+    }
+    slot.state = SlotState::Running;
+    loop.watch(slot.id, slot.proc);
+}
+
+// ── Persistent sessions ──────────────────────────────────────────────────────
+// One steamcmd per slot logs in once and then gets workshop_download_item
+// commands over stdin, at most SESSION_PIPELINE_DEPTH ahead of the results.
+// An idle session (nothing in flight) is never treated as stalled.
+
+static void startSession(InstanceSlot& slot, EventLoop& loop) {
+    prepareInstance(slot);
+    slot.chunk.clear();
+    slot.session     = true;
+
+    fileLog(slotTag(slot) + " Starting session | dir=" + slot.instanceDir);
+
+    slot.parser.reset(new SteamCmdLogParser({}));
+    openInstanceLog(slot, "session " + std::to_string(slot.batches + 1));
+    slot.batches++;
+    slot.started  = Clock::now();
+    slot.deadline = Clock::time_point::max();
+    if (!spawnChild({ steamcmdExe() }, slot.proc, true)) {
+        finishInstance(slot);
+        return;
+    }
+    slot.state = SlotState::Running;
+    loop.watch(slot.id, slot.proc);
+
+    // Isolated install dir → no shared patch-state-file collisions
+    writeChildInput(slot.proc, "login anonymous\n"
+                               "force_install_dir ./" + slot.instanceDir + "\n");
+}
+
+static void sendSessionItem(InstanceSlot& slot, SkinId id, Clock::time_point now) {
+    slot.chunk.push_back(id);
+    slot.parser->expect(id);
+    if (slot.inFlight.empty()) {
+        slot.deadline = now + std::chrono::seconds(STALL_WINDOW_SEC);
+        slot.itemMark = now;       // an idle session starts on it right away
+    }
+    slot.inFlight.push_back(id);
+    journal.dispatched(id, itemTable.attempts(id) + 1);
+    eventStream.dispatched(id, itemTable.attempts(id) + 1, slot.id);
+    // A failed write means steamcmd is gone; its exit event settles the item.
+    writeChildInput(slot.proc, "workshop_download_item " + APP_ID + " " + idStr(id) + "\n");
+}
+
+// Drop items that have a result line from the in-flight window.
+static void onSessionProgress(InstanceSlot& slot) {
+    slot.inFlight.erase(std::remove_if(slot.inFlight.begin(), slot.inFlight.end(),
+        [&](SkinId id){ return slot.parser->hasResult(id); }), slot.inFlight.end());
+}
+
+// A new result line is progress: push the stall deadline out (an idle
+// session has no deadline at all).
+static void noteResultProgress(InstanceSlot& slot) {
+    const ParsedLog& p = slot.parser->parsed();
+    int marks = p.successCount + p.failureCount;
+    if (marks == slot.resultMarks || slot.termSent) return;
+    slot.resultMarks = marks;
+    slot.deadline = (slot.session && slot.inFlight.empty() && !slot.quitSent)
+        ? Clock::time_point::max()
+        : Clock::now() + std::chrono::seconds(STALL_WINDOW_SEC);
+}
+
+// Stall check: at the deadline, byte changes in the instance's downloads or
+// content dir since the last sample still count as progress. Otherwise
+// SIGTERM the instance, escalating to SIGKILL after KILL_GRACE_MS.
+// Returns true when the instance was just declared stalled.
+static bool checkInstanceStall(InstanceSlot& slot, Clock::time_point now) {
+    if (slot.state != SlotState::Running) return false;
+    if (!slot.termSent && now >= slot.deadline) {
+        std::uintmax_t bytes = stagedBytes(slot);
+        if (bytes != slot.stagedBytes) {
+            slot.stagedBytes = bytes;
+            slot.deadline    = now + std::chrono::seconds(STALL_WINDOW_SEC);
+            return false;
+        }
+        slot.timedOut   = true;
+        slot.termSent   = true;
+        slot.termSentAt = now;
+        fileLog(slotTag(slot) + " No progress for " + std::to_string(STALL_WINDOW_SEC)
+                + "s. Killing this instance.");
+        terminateChild(slot.proc);
+        return true;
+    } else if (slot.termSent && !slot.killSent &&
+               now - slot.termSentAt >= std::chrono::milliseconds(KILL_GRACE_MS)) {
+        slot.killSent = true;
+        forceKillChild(slot.proc);
+    }
+    return false;
+}
+
+// Count a final result; anything unexpected counts as an Error.
+static SkinResult countFinal(SkinResult sr) {
+    switch (sr) {
+        case SkinResult::Success:
+            successCount++;
+            break;
+        case SkinResult::Timeout:
+            timeoutCount++;        failedCount++; break;
+        case SkinResult::RateLimit:
+            ratelimitCount++;      failedCount++; break;
+        case SkinResult::LockFailed:
+            lockFailCount++;       failedCount++; break;
+        case SkinResult::ValidationFailed:
+            validationFailCount++; failedCount++; break;
+        default:
+            errorCount++;          failedCount++; sr = SkinResult::Error; break;
+    }
+    return sr;
+}
+
+// Move one settled item from the instance dir to the shared dir and record
+// its final result. Called the moment the parser settles the item, so
+// counters and the progress bar advance while steamcmd is still running.
+// `present`: the mover found the skin in the shared dir. `timedOut` /
+// `interrupted` describe the run the item came from, captured when it was
+// handed to the mover – the slot may have started another run since.
+static void completeItem(InstanceSlot& slot, SkinId id, SkinResult sr,
+                         bool timedOut, bool interrupted, bool present) {
+    if (present) {
+        sr = SkinResult::Success;
+    } else if (sr == SkinResult::Success) {
+        // steamcmd reported success but no files materialised
+        sr = SkinResult::ValidationFailed;
+        fileLog("WARN: steamcmd said Success for " + itemLabel(id) + " but no files found – "
+                "treating as ValidationFailed (will retry).");
+    }
+
+    int attempt = itemTable.attempts(id) + 1;
+
+    // Cut off by a stop request: no attempt used, the resumed run redoes it.
+    if (interrupted && sr != SkinResult::Success) {
+        eventStream.verified(id, attempt, slot.id, sr, "open");
+        return;
+    }
+
+    // Hard-timeout overrides anything that isn't already a success
+    if (timedOut && sr != SkinResult::Success)
+        sr = SkinResult::Timeout;
+
+    slot.outcomes.push_back(sr);
+
+    // Attempts left: hand it back to the supervisor to requeue, count nothing yet.
+    if (sr != SkinResult::Success && ++itemTable.attempts(id) <= MAX_ITEM_RETRIES) {
+        auto cleanFrom = Clock::now();
+        cleanItemStaging(slot.instanceDir, id);
+        trace.span(TraceWriter::SUPERVISOR_TRACK, "cleanup", "clean item staging", cleanFrom, Clock::now(),
+                   traceArgs(id, attempt) + ",\"slot\":" + std::to_string(slot.id));
+        slot.retries.emplace_back(id, sr);
+        journal.retrying(id, itemTable.attempts(id), sr);
+        eventStream.verified(id, attempt, slot.id, sr, "retry");
+        return;
+    }
+
+    sr = countFinal(sr);
+    eventStream.verified(id, attempt, slot.id, sr, sr == SkinResult::Success ? "done" : "failed");
+    totalProcessed++;
+    journal.finished(id, itemTable.attempts(id) + (sr == SkinResult::Success ? 1 : 0), sr);
+
     std::lock_guard<std::mutex> lk(resultMtx);
-    for (const auto& id : ids) {
-        auto it = skinResults.find(id);
-        if (it != skinResults.end() &&
-            it->second != SkinResult::Success &&
-            it->second != SkinResult::Skipped)
-            out.push_back(id);
+    itemTable.result(id) = sr;
+}
+
+static void reconcileItem(InstanceSlot& slot, SkinId id, SkinResult sr) {
+    if (slot.mover) {
+        MoveJob job;
+        job.slot        = slot.id;
+        job.instanceDir = slot.instanceDir;
+        job.id          = id;
+        job.parsed      = sr;
+        job.timedOut    = slot.timedOut;
+        job.interrupted = slot.interrupted;
+        slot.mover->submit(std::move(job));
+        return;
+    }
+    auto moveFrom = Clock::now();
+    bool present  = moveSkinToShared(slot.instanceDir, id);
+    eventStream.moved(id, itemTable.attempts(id) + 1, slot.id, present, false, Clock::now());
+    trace.span(TraceWriter::SUPERVISOR_TRACK, "move", "move " + idStr(id), moveFrom, Clock::now(),
+               traceArgs(id, itemTable.attempts(id) + 1) + ",\"slot\":" + std::to_string(slot.id));
+    completeItem(slot, id, sr, slot.timedOut, slot.interrupted, present);
+}
+
+static void reconcileSettled(InstanceSlot& slot) {
+    bool atExit = slot.state != SlotState::Running;   // settled by finish(), not a result line
+    for (auto& item : slot.parser->takeSettled()) {
+        if (slot.released.count(item.first)) continue;
+        int attempt = itemTable.attempts(item.first) + 1;
+        eventStream.result(item.first, attempt, slot.id, item.second, atExit);
+        if (trace.enabled()) {
+            // Items run one after another: this one began when the previous
+            // one settled, or once steamcmd had logged in.
+            auto now  = Clock::now();
+            auto from = slot.itemMark;
+            if (slot.loginAt != Clock::time_point::max()) from = std::max(from, slot.loginAt);
+            trace.span(TraceWriter::slotTrack(slot.id), "item", itemLabel(item.first), from, now,
+                       traceArgs(item.first, attempt) + ",\"result\":\"" + resultName(item.second)
+                       + "\"" + (atExit ? ",\"exit\":true" : ""));
+            slot.itemMark = now;
+        }
+        reconcileItem(slot, item.first, item.second);
+    }
+
+    // Everything this instance still owns is done and the rest was stolen:
+    // stop it before it re-downloads items another slot is working on.
+    if (slot.state != SlotState::Running || slot.termSent || slot.released.empty()) return;
+    for (const auto& id : slot.chunk)
+        if (!slot.parser->isSettled(id) && !slot.released.count(id)) return;
+    fileLog(slotTag(slot) + " Remaining items were stolen – stopping this instance.");
+    slot.termSent   = true;
+    slot.termSentAt = Clock::now();
+    terminateChild(slot.proc);
+}
+
+static void onInstanceOutput(InstanceSlot& slot, const std::string& data) {
+    if (slot.log.is_open()) slot.log.write(data.data(), (std::streamsize)data.size());
+    slot.parser->feed(data.data(), data.size());
+    if (slot.outputAt == Clock::time_point::max()) {
+        slot.outputAt = Clock::now();
+        trace.span(TraceWriter::slotTrack(slot.id), "instance", "spawn", slot.started, slot.outputAt);
+    }
+    if (slot.loginAt == Clock::time_point::max() && slot.parser->parsed().loggedIn) {
+        slot.loginAt = Clock::now();
+        trace.span(TraceWriter::slotTrack(slot.id), "instance", "login", slot.outputAt, slot.loginAt);
+    }
+    if (slot.session) onSessionProgress(slot);
+    noteResultProgress(slot);
+    reconcileSettled(slot);
+}
+
+// steamcmd renamed a finished item into the instance's content dir: move it
+// to the shared dir now. Its result line later finds it there (reconcileItem).
+static void onItemReady(InstanceSlot& slot, SkinId id) {
+    if (slot.released.count(id) || !slot.parser || slot.parser->isSettled(id)) return;
+    if (std::find(slot.chunk.begin(), slot.chunk.end(), id) == slot.chunk.end()) return;
+    if (!slot.mover) {
+        auto moveFrom = Clock::now();
+        bool present  = moveSkinToShared(slot.instanceDir, id);
+        eventStream.moved(id, itemTable.attempts(id) + 1, slot.id, present, true, Clock::now());
+        trace.span(TraceWriter::SUPERVISOR_TRACK, "move", "move " + idStr(id), moveFrom, Clock::now(),
+                   traceArgs(id, itemTable.attempts(id) + 1) + ",\"slot\":" + std::to_string(slot.id));
+        return;
+    }
+    MoveJob job;
+    job.slot        = slot.id;
+    job.instanceDir = slot.instanceDir;
+    job.id          = id;
+    job.reconcile   = false;
+    slot.mover->submit(std::move(job));
+}
+
+// The instance exited (or never started): settle whatever is still open and
+// log the chunk summary.
+static void finishInstance(InstanceSlot& slot) {
+    std::string exitInfo = slot.proc.reaped ? " | " + describeExit(slot.proc) : " | spawn failed";
+    if (slot.timedOut) forceKillChild(slot.proc); // stragglers that outlived the leader
+    closeChild(slot.proc);
+    if (slot.log.is_open()) slot.log.close();
+    slot.state = SlotState::Idle;
+
+    long long dur = std::chrono::duration_cast<std::chrono::seconds>(
+                        Clock::now() - slot.started).count();
+    if (!slot.session) try { fs::remove(slot.scriptPath); } catch (...) {}
+
+    slot.parser->finish();
+    const ParsedLog& parsed = slot.parser->parsed();
+
+    fileLog(slotTag(slot) + " Finished in " + std::to_string(dur) + "s"
+            + (slot.session ? " | items=" + std::to_string(slot.chunk.size()) : std::string())
+            + " | OK="     + std::to_string(parsed.successCount)
+            + " Fail="     + std::to_string(parsed.failureCount)
+            + " RL="       + std::to_string(parsed.globalRateLimit)
+            + " TM="       + std::to_string(parsed.globalTimeout)
+            + " LK="       + std::to_string(parsed.globalLockFailed)
+            + " VF="       + std::to_string(parsed.globalValidationFail)
+            + exitInfo);
+
+    // A session that died before any result line would only be restarted by
+    // the next dispatch: back off, and give the slot up after a few in a row.
+    // (A batch's items settle as failed instead and use up their retries.)
+    if (slot.session) {
+        if (parsed.successCount + parsed.failureCount > 0 || slot.quitSent || slot.timedOut) {
+            slot.failedStarts = 0;
+        } else if (++slot.failedStarts >= SESSION_FAIL_LIMIT) {
+            slot.givenUp = true;
+            logMain("WARN: " + slotTag(slot) + " steamcmd session failed " + std::to_string(slot.failedStarts)
+                    + " times in a row – not using this instance again (see logs/instance_t"
+                    + std::to_string(slot.id) + ".log).", Col::Yellow);
+        } else {
+            int sec = SESSION_RESTART_SEC << (slot.failedStarts - 1);
+            slot.restartAt = Clock::now() + std::chrono::seconds(sec);
+            fileLog(slotTag(slot) + " Session ended before any result – restarting in "
+                    + std::to_string(sec) + "s");
+        }
+    }
+
+    // Items with no final result line yet (cut off, timed out, never reached)
+    reconcileSettled(slot);
+
+    // Clean staging again so the next run on this instance dir starts fresh
+    auto cleanFrom = Clock::now();
+    cleanStagingFolder(slot.instanceDir);
+    if (trace.enabled()) {
+        int tid = TraceWriter::slotTrack(slot.id);
+        auto now = Clock::now();
+        if (slot.outputAt == Clock::time_point::max())
+            trace.span(tid, "instance", "spawn", slot.started, now, "\"output\":false");
+        trace.span(tid, "cleanup", "clean staging", cleanFrom, now);
+        trace.span(tid, "instance", (slot.session ? "session " : "batch ") + std::to_string(slot.batches),
+                   slot.preparedAt, now,
+                   "\"items\":" + std::to_string(slot.chunk.size()) + ",\"exit\":"
+                   + TraceWriter::jsonString(exitInfo.substr(3)));
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  INSTANCE TEMPLATE
+//
+//  steamcmd is run once against TEMPLATE_DIR (login + quit) so the install
+//  dir skeleton and any steamcmd self-update happen before the instances
+//  start rather than in each of them. Only a run that exits 0 writes
+//  TEMPLATE_STAMP; until then every start bootstraps again (steamapps/
+//  alone only shows that force_install_dir ran). Every
+//  instance dir then gets a clone of the template. Files are reflinked with
+//  FICLONE where the filesystem supports it (btrfs, XFS, ...) and copied
+//  otherwise. Hardlinks are not used: steamcmd rewrites its state files in
+//  place, which would leak one instance's state into all the others.
+// ─────────────────────────────────────────────────────────────────────────────
+static bool bootstrapTemplate() {
+    if (fs::exists(TEMPLATE_STAMP) && fs::exists(fs::path(TEMPLATE_DIR) / "steamapps")) return true;
+    try { fs::create_directories(TEMPLATE_DIR); } catch (...) {}
+
+    logMain("Bootstrapping instance template (" + TEMPLATE_DIR + ")...", Col::Cyan);
+    auto t0 = Clock::now();
+
+    ChildProc proc;
+    if (!spawnChild({ steamcmdExe(), "+force_install_dir", "./" + TEMPLATE_DIR,
+                      "+login", "anonymous", "+quit" }, proc))
+        return false;
+
+    std::ofstream log(LOG_DIR + "/template.log", std::ios::out | std::ios::binary | std::ios::trunc);
+    EventLoop loop;
+    loop.watch(0, proc);
+    auto deadline = t0 + std::chrono::seconds(TEMPLATE_TIMEOUT_SEC);
+    bool exited = false, killed = false;
+    std::vector<LoopEvent> events;
+    stopLoop = &loop;
+    while (!exited) {
+        auto now = Clock::now();
+        if (!killed && stopSignals.load() > 0) {
+            fileLog("Stop requested – killing the template bootstrap.");
+            forceKillChild(proc);
+            killed = true;
+        } else if (!killed && now >= deadline) {
+            fileLog("WARN: Template bootstrap timed out – killing steamcmd.");
+            forceKillChild(proc);
+            killed = true;
+        }
+        if (killed) deadline = Clock::time_point::max();
+        int waitMs = (int)std::min<long long>(STATUS_POLL_MS,
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+        loop.wait(std::max(0, waitMs), events);
+        for (auto& ev : events) {
+            if (ev.kind == LoopEvent::Kind::Output) log << ev.data;
+            else exited = true;
+        }
+    }
+    stopLoop = nullptr;
+    loop.unwatch(0);
+    std::string exitInfo = describeExit(proc);
+    bool clean = exitedCleanly(proc) && !killed;
+    closeChild(proc);
+
+    long long dur = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - t0).count();
+    fileLog("Template bootstrap finished in " + std::to_string(dur) + "s | " + exitInfo);
+    bool usable = fs::exists(fs::path(TEMPLATE_DIR) / "steamapps");
+    if (clean && usable) {
+        std::ofstream(TEMPLATE_STAMP) << timestamp() << " " << exitInfo << "\n";
+    } else if (usable) {
+        fileLog("WARN: Template bootstrap did not exit cleanly – using it for now, "
+                "it is bootstrapped again on the next start.");
+    }
+    return usable && !killed;
+}
+
+// Clone one file; true if it was reflinked rather than copied.
+static bool cloneFile(const fs::path& src, const fs::path& dst) {
+#ifndef _WIN32
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in >= 0) {
+        // Same permissions as the template file (exec bit included), like copy_file
+        struct stat sb;
+        bool ok  = fstat(in, &sb) == 0;
+        int  out = ok ? open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sb.st_mode & 07777) : -1;
+        ok = out >= 0 && fchmod(out, sb.st_mode & 07777) == 0 && ioctl(out, FICLONE, in) == 0;
+        if (out >= 0) close(out);
+        close(in);
+        if (ok) return true;
+    }
+#endif
+    fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+    return false;
+}
+
+// Fill in whatever the instance dir is missing from the template. Files the
+// instance already has are left alone.
+static void cloneTemplateInto(const std::string& instanceDir, int& reflinked, int& copied) {
+    try {
+        for (auto& e : fs::recursive_directory_iterator(TEMPLATE_DIR)) {
+            fs::path dst = fs::path(instanceDir) / fs::relative(e.path(), TEMPLATE_DIR);
+            if (e.is_directory()) {
+                fs::create_directories(dst);
+            } else if (e.is_regular_file() && !fs::exists(dst)) {
+                fs::create_directories(dst.parent_path());
+                if (cloneFile(e.path(), dst)) reflinked++;
+                else                          copied++;
+            }
+        }
+    } catch (const std::exception& ex) {
+        fileLog("WARN: Could not clone template into " + instanceDir + ": " + ex.what());
+    }
+}
+
+static void prepareInstanceDirs(int instances) {
+    if (!USE_INSTANCE_TEMPLATE) return;
+    if (!bootstrapTemplate()) {
+        if (stopSignals.load() > 0) return;
+        logMain("WARN: Template bootstrap failed – instances will bootstrap themselves.", Col::Yellow);
+        return;
+    }
+    auto t0 = Clock::now();
+    int reflinked = 0, copied = 0;
+    for (int i = 0; i < instances; ++i)
+        cloneTemplateInto(INST_DIR_PREFIX + std::to_string(i), reflinked, copied);
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+    fileLog("Template cloned into " + std::to_string(instances) + " instance dir(s) in "
+            + std::to_string(ms) + "ms | reflinked=" + std::to_string(reflinked)
+            + " copied=" + std::to_string(copied));
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  SKIN CONFIG PARSER
+//
+//  ImportedSkins.json is memory-mapped and read by a streaming JSON parser in
+//  one pass into the SkinCatalog. Every quoted 6–12 digit string, key or
+//  value, is a skin ID (as before – plugins nest their lists differently);
+//  when the value of such a key is an object, its itemShortname /
+//  itemDisplayname / permission strings go into that skin's row.
+//  A file that isn't valid JSON falls back to a plain scan for quoted IDs.
+// ─────────────────────────────────────────────────────────────────────────────
+// Read-only mapping of a whole file; data() is null if it couldn't be mapped.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return;
+        void* v = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!v) return;
+        ptr = static_cast<const char*>(v);
+        len = (size_t)sz.QuadPart;
+#else
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat sb;
+        if (fstat(fd, &sb) != 0 || sb.st_size == 0) return;
+        void* v = mmap(nullptr, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (v == MAP_FAILED) return;
+        madvise(v, (size_t)sb.st_size, MADV_SEQUENTIAL);
+        ptr = static_cast<const char*>(v);
+        len = (size_t)sb.st_size;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (ptr) munmap(const_cast<char*>(ptr), len);
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return ptr; }
+    size_t      size() const { return len; }
+
+private:
+    const char* ptr = nullptr;
+    size_t      len = 0;
+#ifdef _WIN32
+    HANDLE file    = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int    fd      = -1;
+#endif
+};
+
+// A quoted 6–12 digit string -> ID, else 0.
+static SkinId configId(std::string_view s) {
+    if (s.size() < 6 || s.size() > 12) return 0;
+    SkinId id = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return 0;
+        id = id * 10 + (SkinId)(c - '0');
+    }
+    return id;
+}
+
+static void appendUtf8(std::string& out, std::uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+// Decode the JSON string starting after the opening quote at `p` into `view`:
+// straight into the mapping when there are no escapes, otherwise via `out`.
+// Returns the position after the closing quote, or null if it's malformed.
+static const char* readJsonString(const char* p, const char* end, std::string& out,
+                                  std::string_view& view) {
+    const char* bs = p;                             // keys and values are short: plain loop
+    while (bs < end && *bs != '"' && *bs != '\\') ++bs;
+    if (bs >= end) return nullptr;
+    if (*bs == '"') {
+        view = std::string_view(p, (size_t)(bs - p));
+        return bs + 1;
+    }
+    out.clear();
+    for (;;) {
+        out.append(p, bs);
+        if (*bs == '"') {
+            view = out;
+            return bs + 1;
+        }
+        if (bs + 1 >= end) return nullptr;
+        p = bs + 2;
+        switch (bs[1]) {
+            case '"':  out += '"';  break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/';  break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u': {
+                auto hex4 = [&](const char* h, std::uint32_t& v) {
+                    if (end - h < 4) return false;
+                    v = 0;
+                    for (int k = 0; k < 4; ++k) {
+                        char c = h[k];
+                        v <<= 4;
+                        if      (c >= '0' && c <= '9') v |= (std::uint32_t)(c - '0');
+                        else if (c >= 'a' && c <= 'f') v |= (std::uint32_t)(c - 'a' + 10);
+                        else if (c >= 'A' && c <= 'F') v |= (std::uint32_t)(c - 'A' + 10);
+                        else return false;
+                    }
+                    return true;
+                };
+                std::uint32_t cp, lo;
+                if (!hex4(p, cp)) return nullptr;
+                p += 4;
+                if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u'
+                    && hex4(p + 2, lo) && lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    p += 6;
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default: return nullptr;
+        }
+        bs = p;
+        while (bs < end && *bs != '"' && *bs != '\\') ++bs;
+        if (bs >= end) return nullptr;
+    }
+}
+
+// One pass over the whole document. Returns false (catalog partly filled) if
+// it isn't valid JSON.
+static bool parseSkinConfig(const char* p, const char* end, SkinCatalog& cat) {
+    struct Frame {
+        bool   object;
+        size_t row;     // skin whose fields this object holds, or npos
+    };
+    std::vector<Frame> stack;
+    std::string      buf, key;
+    std::string_view str;
+    bool   expectKey  = false;
+    size_t pendingRow = SkinCatalog::npos;  // ID key just read; an object value belongs to it
+
+    while (p < end) {
+        char c = *p;
+        switch (c) {
+            case ' ': case '\t': case '\n': case '\r':
+                ++p;
+                continue;
+            case '{':
+            case '[':
+                stack.push_back({ c == '{', c == '{' ? pendingRow : SkinCatalog::npos });
+                expectKey  = c == '{';
+                pendingRow = SkinCatalog::npos;
+                ++p;
+                continue;
+            case '}':
+            case ']':
+                if (stack.empty() || stack.back().object != (c == '}')) return false;
+                stack.pop_back();
+                expectKey = false;
+                ++p;
+                continue;
+            case ',':
+                if (stack.empty()) return false;
+                expectKey  = stack.back().object;
+                pendingRow = SkinCatalog::npos;
+                ++p;
+                continue;
+            case ':':
+                if (stack.empty() || !stack.back().object) return false;
+                ++p;
+                continue;
+            case '"': {
+                p = readJsonString(p + 1, end, buf, str);
+                if (!p) return false;
+                SkinId id = configId(str);
+                size_t row = id ? cat.append(id) : SkinCatalog::npos;
+                if (expectKey) {
+                    key.assign(str);
+                    expectKey  = false;
+                    pendingRow = row;
+                } else if (!stack.empty() && stack.back().object
+                           && stack.back().row != SkinCatalog::npos) {
+                    size_t owner = stack.back().row;
+                    if      (key == "itemShortname")   cat.setShortname(owner, str);
+                    else if (key == "itemDisplayname") cat.setDisplayName(owner, str);
+                    else if (key == "permission")      cat.setPermission(owner, str);
+                }
+                continue;
+            }
+            default: {
+                // number / true / false / null: never an ID (those are quoted)
+                const char* tok = p;
+                while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ':'
+                       && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+                    ++p;
+                std::string_view lit(tok, (size_t)(p - tok));
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    for (char d : lit)
+                        if (!((d >= '0' && d <= '9') || d == '-' || d == '+' || d == '.'
+                              || d == 'e' || d == 'E')) return false;
+                } else if (lit != "true" && lit != "false" && lit != "null") {
+                    return false;
+                }
+                pendingRow = SkinCatalog::npos;
+                continue;
+            }
+        }
+    }
+    return stack.empty();
+}
+
+// Not JSON after all: take every quote followed by 6–12 digits and a closing
+// quote, like the original regex scan did.
+static void scanQuotedIds(const char* p, const char* end, SkinCatalog& cat) {
+    const char* q = p;
+    while ((q = static_cast<const char*>(std::memchr(q, '"', (size_t)(end - q)))) != nullptr) {
+        const char* d  = q + 1;
+        SkinId      id = 0;
+        while (d < end && d - q <= 13 && (unsigned char)(*d - '0') < 10)
+            id = id * 10 + (SkinId)(*d++ - '0');
+        size_t digits = (size_t)(d - q - 1);
+        if (digits >= 6 && digits <= 12 && d < end && *d == '"') {
+            if (id != 0) cat.append(id);
+            q = d + 1;      // the closing quote can't open the next match
+        } else {
+            q = d;          // no quote among the digits: resume at the first non-digit
+        }
+    }
+}
+
+// Fill `cat` from the skin config. False if the file wasn't valid JSON (the
+// IDs are still there, without metadata).
+static bool loadSkinConfig(const std::string& jsonFile, SkinCatalog& cat) {
+    MappedFile  map(jsonFile);
+    std::string fallback;   // empty file, or one that can't be mapped
+    const char* p   = map.data();
+    size_t      len = map.size();
+    if (!p) {
+        std::ifstream file(jsonFile, std::ios::binary);
+        fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        p   = fallback.data();
+        len = fallback.size();
+    }
+    if (len >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) { p += 3; len -= 3; } // UTF-8 BOM
+
+    SkinCatalog parsed;
+    if (parseSkinConfig(p, p + len, parsed)) {
+        parsed.finish();
+        cat = std::move(parsed);
+        return true;
+    }
+    scanQuotedIds(p, p + len, cat);
+    cat.finish();
+    return false;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  DISPATCH PRIORITY
+//
+//  PRIORITY_FILE ranks skins by their line in it: either directly by ID or
+//  through the item type / permission ImportedSkins.json gives them, so the
+//  skins players actually use finish first when a run is cut short.
+// ─────────────────────────────────────────────────────────────────────────────
+struct PriorityRule {
+    bool          permission;   // else shortname
+    bool          prefix;       // pattern ended in '*'
+    std::string   pattern;
+    std::uint32_t rank;
+
+    bool matches(const std::string& v) const {
+        if (v.empty()) return false;
+        return prefix ? v.compare(0, pattern.size(), pattern) == 0 : v == pattern;
+    }
+};
+
+static std::string trimmed(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    size_t e = s.find_last_not_of(" \t\r");
+    return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+}
+
+// Rank every catalog row from PRIORITY_FILE (first matching line wins).
+// Returns the number of ranked skins; a missing file ranks none.
+static size_t loadPriorities(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) return 0;
+
+    std::vector<PriorityRule> rules;
+    std::string   ln;
+    std::uint32_t lineNo = 0;
+    while (std::getline(in, ln)) {
+        std::string rule = trimmed(ln);
+        lineNo++;
+        if (rule.empty() || rule[0] == '#') continue;
+        if (SkinId id = skinindex::parseId(rule)) {
+            size_t row = catalog.row(id);
+            if (row != SkinCatalog::npos) itemTable.setRank(row, lineNo);
+            continue;
+        }
+        size_t eq = rule.find('=');
+        std::string field = eq == std::string::npos ? std::string() : trimmed(rule.substr(0, eq));
+        if (field != "shortname" && field != "permission") {
+            fileLog("[WARN] " + file + ":" + std::to_string(lineNo) + " ignored: " + rule);
+            continue;
+        }
+        PriorityRule r;
+        r.permission = field == "permission";
+        r.pattern    = trimmed(rule.substr(eq + 1));
+        r.prefix     = !r.pattern.empty() && r.pattern.back() == '*';
+        if (r.prefix) r.pattern.pop_back();
+        r.rank       = lineNo;
+        rules.push_back(std::move(r));
+    }
+
+    size_t ranked = 0;
+    for (size_t row = 0; row < catalog.size(); ++row) {
+        for (const auto& r : rules) {
+            if (r.rank >= itemTable.rankAt(row)) break;   // rules are in rank order
+            if (r.matches(r.permission ? catalog.permission(row) : catalog.shortname(row))) {
+                itemTable.setRank(row, r.rank);
+                break;
+            }
+        }
+        if (itemTable.rankAt(row) != ItemTable::UNRANKED) ranked++;
+    }
+    return ranked;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  WORK QUEUE
+//
+//  Idle slots pull small batches from one shared queue instead of getting a
+//  fixed slice of the ID list up front, so a slot that hits huge skins or lock
+//  failures simply takes fewer batches. Once the queue is empty an idle slot
+//  steals the not-yet-started tail of the busiest running instance.
+//  Failed items wait in the queue until their retry backoff has passed and
+//  then go back on the end of it, so retries overlap with first attempts.
+//  The queue is split into one FIFO per dispatch rank; lower ranks are always
+//  drained first, retries and requeued work included.
+//  Only the supervisor thread touches the queue and the slots.
+// ─────────────────────────────────────────────────────────────────────────────
+class WorkQueue {
+public:
+    explicit WorkQueue(const std::vector<SkinId>& ids) {
+        for (const auto& id : ids) tierOf(id).push_back(id);
+        count = ids.size();
+    }
+
+    std::vector<SkinId> take(size_t n) {
+        std::vector<SkinId> out;
+        out.reserve(std::min(n, count));
+        while (out.size() < n && !tiers.empty()) {
+            auto& q = tiers.begin()->second;
+            out.push_back(q.front());
+            q.pop_front();
+            if (q.empty()) tiers.erase(tiers.begin());
+        }
+        count -= out.size();
+        return out;
+    }
+
+    // Put items back at the front of their tier (work a dead session never started).
+    void requeue(const std::vector<SkinId>& ids) {
+        for (auto it = ids.rbegin(); it != ids.rend(); ++it) tierOf(*it).push_front(*it);
+        count += ids.size();
+    }
+
+    // Hold an item back until `when`, then append it.
+    void retryAt(SkinId id, Clock::time_point when) {
+        waiting.emplace(when, id);
+    }
+
+    // Move every retry whose backoff has passed onto the queue.
+    void promoteDue(Clock::time_point now) {
+        while (!waiting.empty() && waiting.begin()->first <= now) {
+            tierOf(waiting.begin()->second).push_back(waiting.begin()->second);
+            waiting.erase(waiting.begin());
+            count++;
+        }
+    }
+
+    Clock::time_point nextRetry() const {
+        return waiting.empty() ? Clock::time_point::max() : waiting.begin()->first;
+    }
+
+    // Empty the queue, retries still in backoff included.
+    std::vector<SkinId> takeAll() {
+        std::vector<SkinId> out = take(count);
+        for (const auto& w : waiting) out.push_back(w.second);
+        waiting.clear();
+        return out;
+    }
+
+    bool   empty()        const { return count == 0; }
+    size_t size()         const { return count; }
+    size_t waitingCount() const { return waiting.size(); }
+
+private:
+    std::map<std::uint32_t, std::deque<SkinId>> tiers;  // rank -> FIFO, never empty
+    size_t                                      count = 0;
+    std::multimap<Clock::time_point, SkinId>    waiting;
+
+    std::deque<SkinId>& tierOf(SkinId id) { return tiers[itemTable.rank(id)]; }
+};
+
+static Clock::time_point retryTime(int attempt, SkinResult sr, Clock::time_point now) {
+    long long sec = (long long)RETRY_BACKOFF_SEC << std::min(attempt - 1, 6);
+    if (sr == SkinResult::RateLimit) sec = std::max<long long>(sec, RATELIMIT_BACKOFF_SEC);
+    return now + std::chrono::seconds(sec);
+}
+
+// Requeue the failures a slot handed back, each after its own backoff.
+static void scheduleRetries(InstanceSlot& slot, WorkQueue& queue) {
+    auto now = Clock::now();
+    for (const auto& r : slot.retries) {
+        int attempt = itemTable.attempts(r.first);
+        auto when   = retryTime(attempt, r.second, now);
+        fileLog(slotTag(slot) + " " + itemLabel(r.first) + " " + resultName(r.second) + " – retry "
+                + std::to_string(attempt) + "/" + std::to_string(MAX_ITEM_RETRIES) + " in "
+                + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(when - now).count())
+                + "s");
+        queue.retryAt(r.first, when);
+        trace.asyncSpan("backoff", "retry backoff", r.first, now, when,
+                        traceArgs(r.first, attempt + 1) + ",\"after\":\"" + resultName(r.second) + "\"");
+        eventStream.queued(r.first, attempt + 1,
+            std::chrono::duration_cast<std::chrono::milliseconds>(when - now).count());
+    }
+    slot.retries.clear();
+    retryWaiting.store((int)queue.waitingCount());
+}
+
+// Token bucket shared by every instance. Only the supervisor thread uses it.
+class DispatchLimiter {
+public:
+    DispatchLimiter()
+        : rate(DISPATCH_RATE_PER_SEC), tokens(DISPATCH_BURST),
+          last(Clock::now()), lastCut(Clock::now() - std::chrono::seconds(RATELIMIT_BACKOFF_SEC)),
+          nextRecover(Clock::time_point::max()) {}
+
+    // Up to `want` tokens, as many as are available (0 = dispatch nothing now).
+    size_t takeUpTo(size_t want, Clock::time_point now) {
+        refill(now);
+        size_t n = std::min(want, (size_t)tokens);
+        tokens -= (double)n;
+        if (n < want) starved = true;
+        return n;
+    }
+
+    bool take(size_t n, Clock::time_point now) { return takeUpTo(n, now) == n; }
+
+    // Some dispatch was held back for lack of tokens since the last reset.
+    bool wasStarved() const { return starved; }
+    void resetStarved()     { starved = false; }
+
+    // When the next whole token will be there (now if one already is).
+    Clock::time_point nextToken(Clock::time_point now) {
+        refill(now);
+        if (tokens >= 1.0) return now;
+        return now + std::chrono::microseconds((long long)((1.0 - tokens) / rate * 1e6) + 1);
+    }
+
+    // A rate limit from any instance: empty the bucket and halve the rate for
+    // everyone. Hits within RATELIMIT_BACKOFF_SEC of a cut are the same event.
+    void onRateLimit(Clock::time_point now, const std::string& who) {
+        refill(now);
+        tokens = 0.0;
+        if (now - lastCut < std::chrono::seconds(RATELIMIT_BACKOFF_SEC)) return;
+        double before = rate;
+        rate        = std::max(DISPATCH_RATE_MIN, rate * 0.5);
+        lastCut     = now;
+        nextRecover = now + std::chrono::seconds(DISPATCH_RECOVER_SEC);
+        logMain(who + " Rate limit – dispatch rate " + fmtRate(before) + " → "
+                + fmtRate(rate) + " items/s", Col::Yellow);
+    }
+
+    // Gradual recovery towards DISPATCH_RATE_PER_SEC while no rate limit is seen.
+    void recover(Clock::time_point now) {
+        if (now < nextRecover) return;
+        double before = rate;
+        rate = std::min(DISPATCH_RATE_PER_SEC, rate + DISPATCH_RATE_PER_SEC * 0.1);
+        nextRecover = rate < DISPATCH_RATE_PER_SEC
+            ? now + std::chrono::seconds(DISPATCH_RECOVER_SEC)
+            : Clock::time_point::max();
+        fileLog("Dispatch rate " + fmtRate(before) + " → " + fmtRate(rate) + " items/s");
+    }
+
+    Clock::time_point nextRecovery() const { return nextRecover; }
+
+private:
+    double            rate;    // tokens per second
+    double            tokens;
+    Clock::time_point last;
+    Clock::time_point lastCut;       // starts a full backoff ago: the first rate limit always cuts
+    Clock::time_point nextRecover;
+    bool              starved = false;
+
+    void refill(Clock::time_point now) {
+        double dt = std::chrono::duration<double>(now - last).count();
+        last   = now;
+        tokens = std::min((double)DISPATCH_BURST, tokens + dt * rate);
+    }
+
+    static std::string fmtRate(double r) {
+        std::ostringstream os;
+        os << std::fixed << std::setprecision(2) << r;
+        return os.str();
+    }
+};
+
+// Fill a session's pipeline up to `depth` as far as the dispatch limiter
+// allows; ask it to quit once there is nothing left, or once it is `draining`
+// (above the concurrency limit).
+static void feedSession(InstanceSlot& slot, WorkQueue& queue, DispatchLimiter& limiter,
+                        size_t depth, bool draining, Clock::time_point now) {
+    if (!slot.session || slot.state != SlotState::Running || slot.termSent || slot.quitSent)
+        return;
+    bool noWork = draining || (queue.empty() && queue.waitingCount() == 0);
+    if (noWork && slot.inFlight.empty()) {
+        writeChildInput(slot.proc, "quit\n");
+        closeChildInput(slot.proc);
+        slot.quitSent = true;
+        slot.deadline = now + std::chrono::seconds(STALL_WINDOW_SEC);
+        return;
+    }
+    if (draining) return;
+    while (!queue.empty() && slot.inFlight.size() < depth && limiter.take(1, now))
+        sendSessionItem(slot, queue.take(1).front(), now);
+}
+
+// Batch size that keeps every slot busy on short lists and caps the cost of a
+// slow batch on long ones.
+static size_t batchSize(size_t queued, int slots) {
+    size_t perSlot = (queued + (size_t)slots - 1) / (size_t)slots;
+    return std::max<size_t>(1, std::min<size_t>(perSlot, DISPATCH_BATCH_SIZE));
+}
+
+// Items of a running instance that steamcmd has not reached yet: everything
+// after the first unsettled item (the one in progress).
+static std::vector<SkinId> unstartedItems(const InstanceSlot& slot) {
+    std::vector<SkinId> out;
+    bool inProgressSeen = false;
+    for (const auto& id : slot.chunk) {
+        if (slot.parser->isSettled(id) || slot.released.count(id)) continue;
+        if (!inProgressSeen) { inProgressSeen = true; continue; }
+        out.push_back(id);
     }
     return out;
 }
 
-static void resetCountersForRetry(const std::vector<std::string>& ids) {
-    std::lock_guard<std::mutex> lk(resultMtx);
-    for (const auto& id : ids) {
-        auto it = skinResults.find(id);
-        if (it == skinResults.end()) continue;
-        switch (it->second) {
-            case SkinResult::Timeout:          timeoutCount--;          break;
-            case SkinResult::RateLimit:        ratelimitCount--;        break;
-            case SkinResult::LockFailed:       lockFailCount--;         break;
-            case SkinResult::ValidationFailed: validationFailCount--;   break;
-            default:                           errorCount--;            break;
+// Take the back half of the busiest instance's unstarted items.
+static std::vector<SkinId> stealWork(std::vector<InstanceSlot>& slots, const InstanceSlot& thief) {
+    InstanceSlot*       victim = nullptr;
+    std::vector<SkinId> best;
+    for (auto& s : slots) {
+        if (s.state != SlotState::Running || s.termSent || s.session) continue;
+        auto tail = unstartedItems(s);
+        if (tail.size() >= (size_t)STEAL_MIN_ITEMS && tail.size() > best.size()) {
+            victim = &s;
+            best   = std::move(tail);
+        }
+    }
+    if (!victim) return {};
+
+    std::vector<SkinId> stolen(best.begin() + (std::ptrdiff_t)(best.size() / 2), best.end());
+    for (const auto& id : stolen) victim->released.insert(id);
+    fileLog(slotTag(thief) + " Stole " + std::to_string(stolen.size())
+            + " item(s) from " + slotTag(*victim));
+    return stolen;
+}
+
+// Items a stalled instance had not started yet (a session's backlog behind
+// the hung item, a batch's unstarted tail): hand them back to the queue
+// instead of failing them as timeouts. Only the hung item costs an attempt.
+static void requeueUnstarted(InstanceSlot& slot, WorkQueue& queue) {
+    std::vector<SkinId> rest;
+    if (slot.session) {
+        if (slot.inFlight.size() < 2) return;
+        rest.assign(slot.inFlight.begin() + 1, slot.inFlight.end());
+        slot.inFlight.resize(1);
+    } else {
+        rest = unstartedItems(slot);
+    }
+    if (rest.empty()) return;
+    for (const auto& id : rest) {
+        slot.released.insert(id);
+        eventStream.queued(id, itemTable.attempts(id) + 1);
+    }
+    queue.requeue(rest);
+    fileLog(slotTag(slot) + " Requeued " + std::to_string(rest.size()) + " unstarted item(s)");
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  CONCURRENCY CONTROLLER
+//
+//  Additive increase / multiplicative decrease on the number of live
+//  instances. Slots with id >= limit() are parked: nothing new is started on
+//  them and a running session there finishes its in-flight items and quits.
+// ─────────────────────────────────────────────────────────────────────────────
+class ConcurrencyController {
+public:
+    explicit ConcurrencyController(int ceiling)
+        : ceiling(ceiling),
+          current(ADAPTIVE_CONCURRENCY ? std::min(ceiling, AIMD_INITIAL) : ceiling),
+          slowStart(true),
+          windowEnd(Clock::now() + std::chrono::seconds(AIMD_WINDOW_SEC)) {}
+
+    int limit() const { return current; }
+
+    void record(SkinResult sr) {
+        samples++;
+        switch (sr) {
+            case SkinResult::RateLimit:  rl++; break;
+            case SkinResult::LockFailed: lk++; break;
+            case SkinResult::Timeout:    tm++; break;
+            default: break;
+        }
+    }
+
+    // Close the window once it is long and full enough and adjust the limit.
+    void update(Clock::time_point now) {
+        if (!ADAPTIVE_CONCURRENCY || now < windowEnd || samples < AIMD_MIN_SAMPLES) return;
+
+        int    bad     = rl + lk + tm;
+        double badRate = (double)bad / samples;
+        int    before  = current;
+        if (badRate > AIMD_BAD_RATE) {
+            current   = std::max(1, (int)(current * AIMD_DECREASE));
+            slowStart = false;
+        } else if (current < ceiling) {
+            current = std::min(ceiling, slowStart ? current * 2 : current + 1);
+        }
+
+        if (current != before || bad > 0) {
+            std::string msg = "[AIMD] " + std::to_string(samples) + " results, bad="
+                + std::to_string((int)(badRate * 100.0 + 0.5)) + "%"
+                + " (RL=" + std::to_string(rl) + " LK=" + std::to_string(lk)
+                + " TM=" + std::to_string(tm) + ") → instances "
+                + std::to_string(before) + " → " + std::to_string(current);
+            if (current < before) logMain(msg, Col::Yellow);
+            else                  fileLog(msg);
+        }
+        samples = rl = lk = tm = 0;
+        windowEnd = now + std::chrono::seconds(AIMD_WINDOW_SEC);
+    }
+
+private:
+    int  ceiling;
+    int  current;
+    bool slowStart;
+    int  samples = 0, rl = 0, lk = 0, tm = 0;
+    Clock::time_point windowEnd;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+//  RUN DOWNLOADS
+//
+//  The calling thread is the supervisor: it owns every steamcmd child, reacts
+//  to output, exits and timeouts from one EventLoop, hands out work from the
+//  WorkQueue and redraws the progress bar in between. No per-instance threads.
+//  Returns once every item has succeeded or used up its retries.
+// ─────────────────────────────────────────────────────────────────────────────
+static void runDownloads(const std::vector<SkinId>& toDownload,
+                         int instances, int grandTotal) {
+    if (toDownload.empty()) return;
+
+    int n = std::min(instances, (int)toDownload.size());
+    WorkQueue queue(toDownload);
+    for (const auto& id : toDownload) eventStream.queued(id, itemTable.attempts(id) + 1);
+
+    ConcurrencyController aimd(n);
+    logMain(std::to_string(toDownload.size()) + " skins → "
+            + (ADAPTIVE_CONCURRENCY ? std::to_string(aimd.limit()) + "-" : std::string())
+            + std::to_string(n) + " isolated steamcmd instance(s), up to "
+            + std::to_string(MAX_ITEM_RETRIES) + " retries per item.", Col::Cyan);
+
+    DispatchLimiter limiter;
+    EventLoop loop;
+    std::vector<InstanceSlot> slots(n); // never resized: the loop holds &slots[i].proc
+    std::unique_ptr<MoverPool> mover;
+    if (MOVER_THREADS > 0) mover.reset(new MoverPool(MOVER_THREADS, loop));
+    for (int i = 0; i < n; ++i) {
+        slots[i].id    = i;
+        slots[i].mover = mover.get();
+        trace.nameTrack(TraceWriter::slotTrack(i), "T" + std::to_string(i));
+    }
+    for (int i = 0; mover && i < MOVER_THREADS; ++i)
+        trace.nameTrack(TraceWriter::moverTrack(i), "mover " + std::to_string(i));
+    int tracedLimit = aimd.limit();
+    trace.counter("instances", Clock::now(), tracedLimit);
+
+    if (MOVE_ON_FINALIZE) {
+        int watched = 0;
+        for (auto& s : slots) {
+            std::string dir = INST_DIR_PREFIX + std::to_string(s.id)
+                            + "/steamapps/workshop/content/" + APP_ID;
+            try { fs::create_directories(dir); } catch (...) {}
+            if (loop.watchDir(s.id, dir)) watched++;
+        }
+        if (watched > 0)
+            fileLog("Watching " + std::to_string(watched) + " instance content dir(s) for finished items");
+    }
+
+    // Hand work to every idle slot: fresh batches first, then stolen tails.
+    // Sessions instead pull single items as their pipeline drains, so the
+    // queue itself balances the load and there is nothing to steal.
+    // Every item handed out (not stolen ones, they were paid for) takes a
+    // token from the shared limiter.
+    // Once stopping, sessions are only asked to quit and nothing new starts.
+    // A slot that was given up on passes its place under the limit on.
+    bool stopping = false;
+    std::vector<bool> parked(slots.size());
+    auto dispatch = [&]() {
+        int  limit = aimd.limit();
+        auto now   = Clock::now();
+        int  live  = 0;
+        for (auto& s : slots)
+            parked[s.id] = s.givenUp || live++ >= limit || stopping;
+        limiter.resetStarved();
+        for (auto& s : slots) {
+            if (PERSISTENT_SESSIONS) {
+                if (s.state == SlotState::Idle && !parked[s.id] && !queue.empty() && now >= s.restartAt)
+                    startSession(s, loop);
+                feedSession(s, queue, limiter, 1, parked[s.id], now); // one each first, then deepen
+                continue;
+            }
+            if (s.state != SlotState::Idle || parked[s.id]) continue;
+            std::vector<SkinId> work = queue.empty()
+                ? stealWork(slots, s)
+                : queue.take(limiter.takeUpTo(batchSize(queue.size(), limit), now));
+            if (work.empty()) continue;
+            startInstance(s, std::move(work), loop);
+        }
+        if (PERSISTENT_SESSIONS)
+            for (auto& s : slots)
+                feedSession(s, queue, limiter, (size_t)SESSION_PIPELINE_DEPTH, parked[s.id], now);
+    };
+
+    // Every slot given up on: nothing left can run, so what is still queued
+    // fails now and the run ends with a report.
+    auto failUnrunnable = [&]() {
+        for (auto& s : slots) if (!s.givenUp) return;
+        std::vector<SkinId> rest = queue.takeAll();
+        if (rest.empty()) return;
+        logMain("ERROR: no steamcmd instance could be started – " + std::to_string(rest.size())
+                + " skin(s) marked failed.", Col::Red);
+        for (const auto& id : rest) {
+            SkinResult sr = countFinal(SkinResult::Error);
+            totalProcessed++;
+            journal.finished(id, itemTable.attempts(id) + 1, sr);
+            eventStream.verified(id, itemTable.attempts(id) + 1, -1, sr, "failed");
+            std::lock_guard<std::mutex> lk(resultMtx);
+            itemTable.result(id) = sr;
+        }
+        retryWaiting.store(0);
+    };
+
+    auto busy = [&]() {
+        if (!stopping && (!queue.empty() || queue.waitingCount() > 0)) return true;
+        if (mover && !mover->idle()) return true;
+        for (auto& s : slots) if (s.state != SlotState::Idle) return true;
+        return false;
+    };
+
+    // First stop signal: drain, killing whatever still runs after
+    // DRAIN_GRACE_SEC. Second one: kill everything and exit now; the journal
+    // has every result so far.
+    auto drainDeadline = Clock::time_point::max();
+    auto checkStop = [&](Clock::time_point now) {
+        int signals = stopSignals.load();
+        if (signals >= 2) {
+            for (auto& s : slots)
+                if (s.state == SlotState::Running) forceKillChild(s.proc);
+            journal.sync(now, true);
+            eventStream.flush();
+            trace.flush();
+            logMain("Stopped immediately – run again to resume.", Col::Red);
+            asyncLog.stop();
+            std::cout << "\n";
+            std::cout.flush();
+            std::_Exit(130);
+        }
+        if (signals >= 1 && !stopping) {
+            stopping      = true;
+            drainDeadline = now + std::chrono::seconds(DRAIN_GRACE_SEC);
+            logMain("Stopping: no new downloads, running instances get "
+                    + std::to_string(DRAIN_GRACE_SEC) + "s to finish. Press Ctrl+C again to quit now.",
+                    Col::Yellow);
+        }
+        if (stopping && now >= drainDeadline) {
+            for (auto& s : slots) {
+                if (s.state != SlotState::Running || s.termSent) continue;
+                fileLog(slotTag(s) + " Still running after the stop grace period – killing it.");
+                s.interrupted = true;
+                s.termSent    = true;
+                s.termSentAt  = now;
+                terminateChild(s.proc);
+            }
+            drainDeadline = Clock::time_point::max();   // SIGKILL follows via checkInstanceStall
+        }
+    };
+
+    stopLoop = &loop;
+    std::vector<LoopEvent> events;
+    auto nextStatus = Clock::now();
+    dispatch();
+    while (busy()) {
+        auto now = Clock::now();
+        checkStop(now);
+        if (now >= nextStatus) {
+            printProgress(grandTotal);
+            nextStatus = now + std::chrono::milliseconds(STATUS_POLL_MS);
+        }
+
+        // Stall checks, retry backoffs and dispatch tokens; the earliest pending
+        // deadline bounds the wait.
+        limiter.recover(now);
+        auto wakeAt = std::min({ nextStatus, queue.nextRetry(), limiter.nextRecovery(),
+                                 journal.nextDue(), drainDeadline });
+        if (limiter.wasStarved()) wakeAt = std::min(wakeAt, limiter.nextToken(now));
+        for (auto& s : slots) {
+            if (checkInstanceStall(s, now))
+                requeueUnstarted(s, queue);
+
+            if (s.state == SlotState::Running) {
+                wakeAt = std::min(wakeAt, s.termSent
+                    ? s.termSentAt + std::chrono::milliseconds(KILL_GRACE_MS)
+                    : s.deadline);
+            } else if (!s.givenUp && s.restartAt > now) {
+                wakeAt = std::min(wakeAt, s.restartAt);
+            }
+        }
+
+        int waitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                         wakeAt - Clock::now()).count();
+        loop.wait(std::max(0, waitMs), events);
+
+        for (auto& ev : events) {
+            InstanceSlot& s = slots[ev.slot];
+            if (ev.kind == LoopEvent::Kind::Output) {
+                onInstanceOutput(s, ev.data);
+            } else if (ev.kind == LoopEvent::Kind::ItemReady) {
+                onItemReady(s, skinindex::parseId(ev.data));
+            } else if (ev.kind == LoopEvent::Kind::Moved) {
+                for (auto& job : mover->takeDone()) {
+                    eventStream.moved(job.id, itemTable.attempts(job.id) + 1, job.slot,
+                                      job.present, !job.reconcile, job.doneAt);
+                    trace.span(TraceWriter::moverTrack(job.worker), "move",
+                               (job.reconcile ? "move " : "early move ") + idStr(job.id),
+                               job.startedAt, job.doneAt,
+                               traceArgs(job.id, itemTable.attempts(job.id) + 1)
+                               + ",\"slot\":" + std::to_string(job.slot)
+                               + ",\"present\":" + (job.present ? "true" : "false"));
+                    if (job.reconcile)
+                        completeItem(slots[job.slot], job.id, job.parsed, job.timedOut,
+                                     job.interrupted, job.present);
+                }
+            } else {
+                loop.unwatch(s.id);
+                finishInstance(s);
+            }
+        }
+        for (auto& s : slots) {
+            int hits = s.parser ? s.parser->parsed().rateLimitHits : 0;
+            if (hits > s.rateLimitSeen) {
+                s.rateLimitSeen = hits;
+                limiter.onRateLimit(Clock::now(), slotTag(s));
+            }
+            for (SkinResult sr : s.outcomes) aimd.record(sr);
+            s.outcomes.clear();
+            scheduleRetries(s, queue);
+        }
+        aimd.update(Clock::now());
+        if (aimd.limit() != tracedLimit) {
+            tracedLimit = aimd.limit();
+            trace.counter("instances", Clock::now(), tracedLimit);
         }
-        failedCount--;
-        totalProcessed--;
-        it->second = SkinResult::Unknown;
+        queue.promoteDue(Clock::now());
+        dispatch();
+        failUnrunnable();
+        journal.sync(Clock::now());
     }
+    stopLoop = nullptr;
+    journal.sync(Clock::now(), true);
+    printProgress(grandTotal);
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
 //  REPORT WRITER
 // ─────────────────────────────────────────────────────────────────────────────
-static void writeReport(const std::vector<std::string>& allIds) {
+static void writeReport(const std::vector<SkinId>& allIds) {
     std::ofstream rep(REPORT_FILE);
     std::ofstream failFile(FAILED_IDS_FILE);
 
@@ -719,18 +3389,33 @@ static void writeReport(const std::vector<std::string>& allIds) {
         << "  Errors:            " << errorCount.load()           << "\n"
         << "  RateLimit:         " << ratelimitCount.load()       << "\n"
         << "  LockFailed:        " << lockFailCount.load()        << "\n"
-        << "  ValidationFailed:  " << validationFailCount.load()  << "\n\n"
-        << "--- Failed skin IDs ---\n";
+        << "  ValidationFailed:  " << validationFailCount.load()  << "\n";
 
     std::lock_guard<std::mutex> lk(resultMtx);
-    for (const auto& id : allIds) {
-        auto it = skinResults.find(id);
-        if (it == skinResults.end()) continue;
-        if (it->second != SkinResult::Success && it->second != SkinResult::Skipped) {
-            rep << id << "  [" << resultName(it->second) << "]\n";
-            failFile << id << "\n";
+    size_t unfinished = 0;
+    for (size_t i = 0; i < itemTable.size(); ++i)
+        if (itemTable.resultAt(i) == SkinResult::Unknown) unfinished++;
+    if (unfinished > 0)
+        rep << "Not finished:        " << unfinished << "  (run was stopped – resume to finish)\n";
+    rep << "\n--- Failed skin IDs ---\n";
+
+    std::map<std::string, int> failedByType;
+    for (size_t i = 0; i < itemTable.size(); ++i) {
+        SkinResult sr = itemTable.resultAt(i);
+        if (sr != SkinResult::Success && sr != SkinResult::Skipped && sr != SkinResult::Unknown) {
+            rep << catalog.id(i) << "  [" << resultName(sr) << "]";
+            if (!catalog.shortname(i).empty())   rep << "  " << catalog.shortname(i);
+            if (!catalog.displayName(i).empty()) rep << "  \"" << catalog.displayName(i) << "\"";
+            rep << "\n";
+            failFile << catalog.id(i) << "\n";
+            failedByType[catalog.shortname(i).empty() ? "(unknown)" : catalog.shortname(i)]++;
         }
     }
+    if (!failedByType.empty()) {
+        rep << "\n--- Failed by item type ---\n";
+        for (const auto& kv : failedByType)
+            rep << std::left << std::setw(24) << kv.first << kv.second << "\n";
+    }
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -738,8 +3423,11 @@ static void writeReport(const std::vector<std::string>& allIds) {
 // ─────────────────────────────────────────────────────────────────────────────
 int main() {
     enableAnsi();
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN); // writing to a dead session's stdin must not kill us
+#endif
     prepareDirs();
-    mainLogFile.open(LOG_DIR + "/main.log", std::ios::out | std::ios::app);
+    asyncLog.start(LOG_DIR + "/main.log");
 
     std::cout << Col::Bold << Col::Cyan
         << "--------------------------------------------------------\n"
@@ -749,28 +3437,61 @@ int main() {
         << Col::Reset;
 
     // ── Pre-flight ────────────────────────────────────────────────────────
-    if (!fs::exists("steamcmd.exe")) {
-        logMain("ERROR: steamcmd.exe not found.", Col::Red); return 1;
+    if (!fs::exists(STEAMCMD_BIN)) {
+        logMain("ERROR: " + STEAMCMD_BIN + " not found.", Col::Red); return 1;
     }
     if (!fs::exists("ImportedSkins.json")) {
         logMain("ERROR: ImportedSkins.json not found.", Col::Red); return 1;
     }
 
-    auto allIds = parseIds("ImportedSkins.json");
+    bool wellFormed = loadSkinConfig("ImportedSkins.json", catalog);
+    const std::vector<SkinId>& allIds = catalog.allIds();
     if (allIds.empty()) {
         logMain("ERROR: No skin IDs found in ImportedSkins.json.", Col::Red); return 1;
     }
-    logMain("Loaded " + std::to_string(allIds.size()) + " unique skin IDs.", Col::Green);
+    if (!wellFormed)
+        logMain("WARN: ImportedSkins.json is not valid JSON – using the IDs only, "
+                "no item names / permissions.", Col::Yellow);
+    logMain("Loaded " + std::to_string(allIds.size()) + " unique skin IDs ("
+            + std::to_string(catalog.distinctShortnames()) + " item types).", Col::Green);
+    itemTable.assign(catalog.size());
+    if (size_t ranked = loadPriorities(PRIORITY_FILE))
+        logMain("Priority: " + std::to_string(ranked) + " skin(s) ranked by " + PRIORITY_FILE
+                + ", dispatched first.", Col::Green);
 
     // ── User input ────────────────────────────────────────────────────────
     int  maxInstances;
     char skipExistingCh;
     char prevFailedCh = 'n';
+    char resumeCh     = 'n';
+    logFlush();
+
+    JournalReplay replay = readJournal(JOURNAL_FILE);
+    if (replay.seen > 0) {
+        std::cout << "\n" << Col::Yellow << "Found an unfinished run (" << replay.finished << " of "
+                  << replay.seen << " started skins done). Resume it? (y/n): " << Col::Reset;
+        std::cin >> resumeCh;
+    }
+    bool resume = replay.seen > 0 && (resumeCh == 'y' || resumeCh == 'Y');
+    if (resume) {
+        for (size_t row = 0; row < catalog.size(); ++row) {
+            SkinId id = catalog.id(row);
+            itemTable.attempts(id) = replay.attempts[row];
+            if (replay.results[row] != SkinResult::Unknown)
+                itemTable.result(id) = countFinal(replay.results[row]);
+        }
+        logMain("Resuming: " + std::to_string(replay.finished) + " skin(s) already done, "
+                + std::to_string(replay.seen - replay.finished) + " picked up again.", Col::Cyan);
+    }
+    replay = JournalReplay();
+    logFlush();
 
     std::cout << "\n" << Col::Yellow
               << "NOTE: Each instance downloads to its own rust_workshop_tN directory\n"
-              << "      to prevent 'Locking Failed' collisions. Recommended: 1-3.\n"
-              << Col::Reset;
+              << "      to prevent 'Locking Failed' collisions. Recommended: 1-3.\n";
+    if (ADAPTIVE_CONCURRENCY)
+        std::cout << "      The count adapts to rate limits / lock failures; this is the maximum.\n";
+    std::cout << Col::Reset;
     std::cout << Col::Yellow << "Max parallel SteamCMD instances: " << Col::Reset;
     std::cin >> maxInstances;
     if (maxInstances < 1) maxInstances = 1;
@@ -779,12 +3500,12 @@ int main() {
     std::cin >> skipExistingCh;
     bool skipExisting = (skipExistingCh == 'y' || skipExistingCh == 'Y');
 
-    std::unordered_set<std::string> prevFailed;
+    std::unordered_set<SkinId> prevFailed;
     if (fs::exists(FAILED_IDS_FILE)) {
         std::ifstream ff(FAILED_IDS_FILE);
         std::string ln;
         while (std::getline(ff, ln))
-            if (!ln.empty()) prevFailed.insert(ln);
+            if (SkinId id = skinindex::parseId(ln)) prevFailed.insert(id);
         std::cout << Col::Yellow << "Found " << prevFailed.size()
                   << " previously-failed IDs. Retry only those? (y/n): " << Col::Reset;
         std::cin >> prevFailedCh;
@@ -793,17 +3514,19 @@ int main() {
                           (prevFailedCh == 'y' || prevFailedCh == 'Y');
 
     // ── Build work list ───────────────────────────────────────────────────
-    std::vector<std::string> toProcess;
+    buildContentIndex();
+    std::vector<SkinId> toProcess;
     for (const auto& id : allIds) {
+        if (itemTable.result(id) != SkinResult::Unknown) continue; // done in the resumed run
         if (onlyPrevFailed && !prevFailed.count(id)) {
             std::lock_guard<std::mutex> lk(resultMtx);
-            skinResults[id] = SkinResult::Skipped;
+            itemTable.result(id) = SkinResult::Skipped;
             skippedCount++;
             continue;
         }
-        if (skipExisting && folderHasFiles(fs::path(CONTENT_PATH) / id)) {
+        if (skipExisting && presentSkins.has(id)) {
             std::lock_guard<std::mutex> lk(resultMtx);
-            skinResults[id] = SkinResult::Skipped;
+            itemTable.result(id) = SkinResult::Skipped;
             skippedCount++;
             continue;
         }
@@ -813,66 +3536,39 @@ int main() {
     int grandTotal = (int)toProcess.size();
     if (grandTotal == 0) {
         logMain("Nothing to download.", Col::Green);
+        logFlush();
         std::cout << "Skipped: " << skippedCount << "\n";
+        if (resume) writeReport(allIds);    // the resumed run is complete now
+        journal.discard();
         return 0;
     }
+    if (!journal.open(resume))
+        logMain("WARN: Could not open " + JOURNAL_FILE + " – this run can't be resumed.", Col::Yellow);
+    if (WRITE_EVENT_STREAM && !eventStream.open(EVENTS_FILE))
+        logMain("WARN: Could not create " + EVENTS_FILE + " – no item events this run.", Col::Yellow);
+    if (WRITE_TRACE && !trace.open(TRACE_FILE))
+        logMain("WARN: Could not create " + TRACE_FILE + " – no timeline this run.", Col::Yellow);
 
     logMain("Skins to download: " + std::to_string(grandTotal)
             + "  |  Already present (skipped): " + std::to_string(skippedCount.load()), Col::Cyan);
     fileLog("=== Session start | total=" + std::to_string(grandTotal)
             + " instances=" + std::to_string(maxInstances) + " ===");
 
-    // ── Initial pass ──────────────────────────────────────────────────────
-    auto tSessionStart = Clock::now();
-    runPass(toProcess, maxInstances, 1, grandTotal);
-
-    // ── Retry passes ──────────────────────────────────────────────────────
-    for (int retry = 1; retry <= MAX_RETRY_PASSES; ++retry) {
-        auto failed = collectFailed(toProcess);
-        if (failed.empty()) {
-            logMain("All items succeeded – no retries needed.", Col::Green);
-            break;
-        }
+    installStopHandlers();      // before the template bootstrap's steamcmd
+    prepareInstanceDirs(std::min(maxInstances, grandTotal));
 
-        // Diagnostic breakdown
-        int vfCount = 0, lkCount = 0;
-        {
-            std::lock_guard<std::mutex> lk(resultMtx);
-            for (const auto& id : failed) {
-                auto it = skinResults.find(id);
-                if (it == skinResults.end()) continue;
-                if (it->second == SkinResult::ValidationFailed) vfCount++;
-                if (it->second == SkinResult::LockFailed)       lkCount++;
-            }
-        }
-
-        logMain("Retry pass " + std::to_string(retry) + "/" + std::to_string(MAX_RETRY_PASSES)
-                + ": " + std::to_string(failed.size()) + " item(s)"
-                + "  [VF=" + std::to_string(vfCount)
-                + " LK=" + std::to_string(lkCount) + "]", Col::Yellow);
-
-        // Wipe ALL instance staging dirs + shared locks before retry
-        for (int i = 0; i < maxInstances; ++i)
-            cleanStagingFolder(INST_DIR_PREFIX + std::to_string(i));
-        cleanSharedPatchFiles();
-
-        if (anyRateLimitDetected.load()) {
-            int backoff = RATELIMIT_BACKOFF_SEC * 2;
-            logMain("Rate-limit detected; sleeping " + std::to_string(backoff) + "s...", Col::Yellow);
-            std::this_thread::sleep_for(std::chrono::seconds(backoff));
-            anyRateLimitDetected.store(false);
-        }
-
-        resetCountersForRetry(failed);
-
-        // Fewer instances on retry to lower rate-limit and lock pressure
-        int retryInst = std::max(1, maxInstances / 2);
-        runPass(failed, retryInst, retry + 1, grandTotal);
-    }
+    auto tSessionStart = Clock::now();
+    cleanSharedPatchFiles(); // remove leftover shared locks before spawning
+    if (stopSignals.load() == 0)
+        runDownloads(toProcess, maxInstances, grandTotal);
+    eventStream.close();
+    trace.close();
+    bool interrupted = stopSignals.load() > 0;
 
     // ── Final summary ─────────────────────────────────────────────────────
     long long totalSec = std::chrono::duration_cast<std::chrono::seconds>(
                              Clock::now() - tSessionStart).count();
+    logFlush();
 
     std::cout << "\n\n"
         << Col::Bold    << "──────────────── Download Complete ────────────────\n" << Col::Reset
@@ -886,16 +3582,21 @@ int main() {
                         << "    ValidationFailed:     " << validationFailCount<< "\n" << Col::Reset
         << "  Total time: " << totalSec / 60 << "m " << totalSec % 60 << "s\n"
         << "────────────────────────────────────────────────────\n";
+    if (interrupted)
+        std::cout << Col::Yellow << "  Interrupted: " << grandTotal - totalProcessed.load()
+                  << " skin(s) not finished – run again and resume.\n" << Col::Reset;
     if (failedCount > 0)
         std::cout << Col::Yellow << "  Failed IDs → " << FAILED_IDS_FILE << "\n" << Col::Reset;
     std::cout << "  Report     → " << REPORT_FILE  << "\n"
               << "  Logs       → " << LOG_DIR       << "/\n\n";
 
     writeReport(allIds);
+    if (interrupted) journal.close();   // kept for the resume
+    else             journal.discard();
     fileLog("=== Session end | success=" + std::to_string(successCount.load())
             + " failed=" + std::to_string(failedCount.load())
             + " time=" + std::to_string(totalSec) + "s ===");
 
-    if (mainLogFile.is_open()) mainLogFile.close();
-    return 0;
+    asyncLog.stop();
+    return interrupted ? 130 : 0;
 }
\ No newline at end of file
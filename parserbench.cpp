@@ -0,0 +1,330 @@
+/*
+ * steamcmd Log Parser Check & Benchmark
+ *
+ * Replays the recorded / synthetic steamcmd logs in parser_corpus/ through the
+ * downloader's log parser (steamcmdlog.h), without steamcmd or a network:
+ *   1. Every <name>.log that has a <name>.expect next to it is parsed twice –
+ *      in one piece and in tiny chunks, so lines split across pipe reads are
+ *      covered – and each item's settled result, the global flags and the
+ *      counters must match the .expect file.
+ *   2. The whole corpus (a .log without .expect is only benchmarked, so large
+ *      recorded logs can simply be dropped in) is replayed in pipe-sized
+ *      chunks for a few seconds; lines/s and MB/s are reported.
+ *
+ * .expect format, one entry per line, '#' starts a comment:
+ *   item <id> <Result>     every item the instance was given, in that order,
+ *                          and the result it must settle with (resultName())
+ *   flags <RL TM LK VF>    global flags that must be set, '-' for none
+ *   ok <n>  fail <n>  rlhits <n>
+ *
+ * Exit code 0 when every case matches, 1 otherwise.
+ *
+ * Usage:         parserbench [corpus_dir] [bench_seconds]
+ * Build (MSVC):  cl /std:c++17 /O2 parserbench.cpp /Fe:parserbench.exe
+ * Build (MinGW): g++ -std=c++17 -O2 parserbench.cpp -o parserbench.exe
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <iomanip>
+#include <iterator>
+
+#include "steamcmdlog.h"
+
+namespace fs = std::filesystem;
+using namespace steamcmdlog;
+
+// =============================================================================
+//  CONFIGURATION
+// =============================================================================
+const std::string DEFAULT_CORPUS_DIR = "parser_corpus";
+const double      DEFAULT_BENCH_SEC  = 3.0;
+const size_t      CHECK_CHUNK        = 7;       // odd size: splits lines and CRLFs
+const size_t      PIPE_CHUNK         = 16384;   // what the downloader reads per event
+
+// =============================================================================
+//  ANSI COLOURS
+// =============================================================================
+namespace Col {
+    const char* Reset   = "\033[0m";
+    const char* Green   = "\033[32m";
+    const char* Yellow  = "\033[33m";
+    const char* Red     = "\033[31m";
+    const char* Cyan    = "\033[36m";
+    const char* Bold    = "\033[1m";
+}
+
+#ifdef _WIN32
+#include <windows.h>
+static void enableAnsi() {
+    HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (h == INVALID_HANDLE_VALUE) return;
+    DWORD mode = 0;
+    GetConsoleMode(h, &mode);
+    SetConsoleMode(h, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+}
+#else
+static void enableAnsi() {}
+#endif
+
+// =============================================================================
+//  CORPUS
+// =============================================================================
+struct Expect {
+    std::vector<std::pair<SkinId, SkinResult>> items;
+    std::string flags = "-";     // sorted, space separated
+    int         ok = 0, fail = 0, rlhits = 0;
+};
+
+struct Case {
+    std::string name;
+    std::string log;
+    bool        hasExpect = false;
+    Expect      expect;
+};
+
+static std::string readFile(const fs::path& p) {
+    std::ifstream in(p, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static std::string sortedFlags(std::vector<std::string> f) {
+    if (f.empty()) return "-";
+    std::sort(f.begin(), f.end());
+    std::string out;
+    for (const auto& s : f) out += (out.empty() ? "" : " ") + s;
+    return out;
+}
+
+// False (with `err`) if the file has a line it doesn't understand.
+static bool loadExpect(const fs::path& p, Expect& e, std::string& err) {
+    std::ifstream in(p);
+    std::string   ln;
+    int           lineNo = 0;
+    while (std::getline(in, ln)) {
+        lineNo++;
+        if (!ln.empty() && ln.back() == '\r') ln.pop_back();
+        if (ln.empty() || ln[0] == '#') continue;
+        std::istringstream ls(ln);
+        std::string key;
+        ls >> key;
+        bool good = true;
+        if (key == "item") {
+            SkinId id = 0;
+            std::string name;
+            SkinResult  sr;
+            good = (ls >> id >> name) && parseResultName(name, sr);
+            if (good) e.items.emplace_back(id, sr);
+        } else if (key == "flags") {
+            std::vector<std::string> f;
+            std::string tok;
+            while (ls >> tok)
+                if (tok != "-") f.push_back(tok);
+            e.flags = sortedFlags(f);
+        } else if (key == "ok") {
+            good = (bool)(ls >> e.ok);
+        } else if (key == "fail") {
+            good = (bool)(ls >> e.fail);
+        } else if (key == "rlhits") {
+            good = (bool)(ls >> e.rlhits);
+        } else {
+            good = false;
+        }
+        if (!good) {
+            err = p.filename().string() + ":" + std::to_string(lineNo) + ": " + ln;
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<Case> loadCorpus(const fs::path& dir, std::vector<std::string>& errors) {
+    std::vector<Case> cases;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".log") continue;
+        Case c;
+        c.name = entry.path().stem().string();
+        c.log  = readFile(entry.path());
+        fs::path exp = entry.path();
+        exp.replace_extension(".expect");
+        if (fs::exists(exp)) {
+            std::string err;
+            if (!loadExpect(exp, c.expect, err)) {
+                errors.push_back(err);
+                continue;
+            }
+            c.hasExpect = true;
+        }
+        cases.push_back(std::move(c));
+    }
+    std::sort(cases.begin(), cases.end(),
+              [](const Case& a, const Case& b) { return a.name < b.name; });
+    return cases;
+}
+
+// =============================================================================
+//  CHECK
+// =============================================================================
+static std::vector<SkinId> itemIds(const Case& c) {
+    std::vector<SkinId> ids;
+    for (const auto& it : c.expect.items) ids.push_back(it.first);
+    return ids;
+}
+
+// Feed the log in `chunk`-sized pieces, as the downloader's pipe reads would,
+// and collect every item as it settles.
+static ParsedLog replay(const Case& c, size_t chunk,
+                        std::vector<std::pair<SkinId, SkinResult>>& settled) {
+    SteamCmdLogParser parser(itemIds(c));
+    for (size_t pos = 0; pos < c.log.size(); pos += chunk) {
+        parser.feed(c.log.data() + pos, std::min(chunk, c.log.size() - pos));
+        for (auto& s : parser.takeSettled()) settled.push_back(s);
+    }
+    parser.finish();
+    for (auto& s : parser.takeSettled()) settled.push_back(s);
+    return parser.parsed();
+}
+
+// Differences from the .expect file, empty when the case passes.
+static std::vector<std::string> checkCase(const Case& c, size_t chunk) {
+    std::vector<std::string> diffs;
+    std::vector<std::pair<SkinId, SkinResult>> settled;
+    ParsedLog parsed = replay(c, chunk, settled);
+
+    for (const auto& want : c.expect.items) {
+        auto got = std::find_if(settled.begin(), settled.end(),
+                                [&](const std::pair<SkinId, SkinResult>& s) { return s.first == want.first; });
+        std::string gotName = got == settled.end() ? "(never settled)" : resultName(got->second);
+        if (got == settled.end() || got->second != want.second)
+            diffs.push_back("item " + std::to_string(want.first) + ": expected "
+                            + resultName(want.second) + ", got " + gotName);
+    }
+    if (settled.size() != c.expect.items.size())
+        diffs.push_back(std::to_string(settled.size()) + " items settled, expected "
+                        + std::to_string(c.expect.items.size()));
+
+    std::vector<std::string> f;
+    if (parsed.globalRateLimit)      f.push_back("RL");
+    if (parsed.globalTimeout)        f.push_back("TM");
+    if (parsed.globalLockFailed)     f.push_back("LK");
+    if (parsed.globalValidationFail) f.push_back("VF");
+    std::string flags = sortedFlags(f);
+    if (flags != c.expect.flags)
+        diffs.push_back("flags: expected " + c.expect.flags + ", got " + flags);
+    auto count = [&](const char* what, int want, int got) {
+        if (want != got)
+            diffs.push_back(std::string(what) + ": expected " + std::to_string(want)
+                            + ", got " + std::to_string(got));
+    };
+    count("ok",     c.expect.ok,     parsed.successCount);
+    count("fail",   c.expect.fail,   parsed.failureCount);
+    count("rlhits", c.expect.rlhits, parsed.rateLimitHits);
+    return diffs;
+}
+
+// =============================================================================
+//  BENCHMARK
+// =============================================================================
+struct BenchResult {
+    double    seconds = 0;
+    long long passes  = 0;
+    long long bytes   = 0;
+    long long lines   = 0;
+};
+
+static BenchResult bench(const std::vector<Case>& cases, double minSeconds) {
+    BenchResult r;
+    long long corpusBytes = 0, corpusLines = 0;
+    for (const auto& c : cases) {
+        corpusBytes += (long long)c.log.size();
+        corpusLines += (long long)std::count(c.log.begin(), c.log.end(), '\n');
+    }
+    if (corpusBytes == 0) return r;
+
+    auto t0 = std::chrono::steady_clock::now();
+    int  sink = 0;
+    do {
+        for (const auto& c : cases) {
+            SteamCmdLogParser parser(itemIds(c));
+            for (size_t pos = 0; pos < c.log.size(); pos += PIPE_CHUNK)
+                parser.feed(c.log.data() + pos, std::min(PIPE_CHUNK, c.log.size() - pos));
+            parser.finish();
+            sink += (int)parser.takeSettled().size();
+        }
+        r.passes++;
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while (r.seconds < minSeconds);
+    r.bytes = corpusBytes * r.passes;
+    r.lines = corpusLines * r.passes;
+    if (sink < 0) std::cout << "";     // keep the replay from being optimised away
+    return r;
+}
+
+// =============================================================================
+//  MAIN
+// =============================================================================
+int main(int argc, char** argv) {
+    enableAnsi();
+    fs::path corpusDir  = argc > 1 ? argv[1] : DEFAULT_CORPUS_DIR;
+    double   benchSec   = argc > 2 ? std::atof(argv[2]) : DEFAULT_BENCH_SEC;
+
+    std::cout << Col::Bold << Col::Cyan
+        << "+------------------------------------------------------+\n"
+        << "|     steamcmd Log Parser Check & Benchmark            |\n"
+        << "+------------------------------------------------------+\n"
+        << Col::Reset << "\n";
+
+    if (!fs::is_directory(corpusDir)) {
+        std::cout << Col::Red << "Corpus directory not found: " << corpusDir.string()
+                  << Col::Reset << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> errors;
+    auto cases = loadCorpus(corpusDir, errors);
+    for (const auto& e : errors)
+        std::cout << Col::Red << "Bad .expect line – " << e << Col::Reset << "\n";
+    if (cases.empty()) {
+        std::cout << Col::Yellow << "No .log files in " << corpusDir.string() << Col::Reset << "\n";
+        return 1;
+    }
+
+    // -- Check ----------------------------------------------------------------
+    int checked = 0, failed = (int)errors.size();
+    for (const auto& c : cases) {
+        if (!c.hasExpect) continue;
+        checked++;
+        auto diffs = checkCase(c, c.log.size() + 1);
+        for (auto& d : checkCase(c, CHECK_CHUNK))
+            if (std::find(diffs.begin(), diffs.end(), d) == diffs.end())
+                diffs.push_back(d + " (chunked)");
+        if (diffs.empty()) {
+            std::cout << Col::Green << "  PASS  " << Col::Reset << c.name << "\n";
+            continue;
+        }
+        failed++;
+        std::cout << Col::Red << "  FAIL  " << Col::Reset << c.name << "\n";
+        for (const auto& d : diffs) std::cout << "          " << d << "\n";
+    }
+    std::cout << "\n" << checked << " case(s) checked, " << failed << " failed.\n\n";
+
+    // -- Benchmark ------------------------------------------------------------
+    if (benchSec > 0) {
+        BenchResult r = bench(cases, benchSec);
+        if (r.seconds > 0) {
+            std::cout << Col::Cyan << "Replayed " << cases.size() << " log(s) x " << r.passes
+                      << " in " << std::fixed << std::setprecision(2) << r.seconds << "s\n"
+                      << Col::Reset
+                      << "  " << std::setprecision(0) << r.lines / r.seconds << " lines/s\n"
+                      << "  " << std::setprecision(1) << r.bytes / r.seconds / 1e6 << " MB/s\n";
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
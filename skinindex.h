@@ -0,0 +1,501 @@
+/*
+ * Skin Index  (shared by the downloader, cleanup, skin installer and .acf patcher)
+ *
+ * One binary file next to a workshop content folder the tools own
+ *   .../workshop/content/252490  ->  .../workshop/content/252490.skinindex
+ * or, for Steam's own workshop folder, in a cache dir next to the tool
+ * (cachedIndexFile()), so nothing unexpected appears in Steam's tree.
+ * holds a fixed-size record per skin folder: total size, file count, newest
+ * file mtime, manifest.txt PublishDate, and the folder's own mtime + inode at
+ * the time it was scanned. The file is memory-mapped; a tool that adds, moves
+ * or removes a skin updates that one record in place, so the next tool can
+ * answer "is it there / how big / how new" without walking the folder again.
+ *
+ * A record is trusted while the folder's mtime and inode still match (one
+ * stat). reconcile() lists the content folder once, without recursing, drops
+ * records whose folder is gone and returns the folders that are new or have
+ * changed since they were indexed; only those need a rescan.
+ *
+ * If the index file can't be created (read-only dir, no permission) the index
+ * still works, it just lives in memory for this run.
+ *
+ * One tool at a time owns the file: it is held with an exclusive lock (share
+ * mode on Windows, flock on Linux) while open. A second tool on the same
+ * folder – cleanup while the downloader runs – gets an in-memory index
+ * instead of rewriting the same records underneath the first.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace skinindex {
+
+namespace fs = std::filesystem;
+
+// =============================================================================
+//  ON-DISK LAYOUT
+// =============================================================================
+const char     MAGIC[8]      = { 'S', 'K', 'I', 'N', 'I', 'D', 'X', '1' };
+const uint32_t VERSION       = 1;
+const uint64_t INITIAL_SLOTS = 1024;   // doubled whenever the file fills up
+const char     CACHE_DIR[]   = "skinindex_cache";
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t used;          // slots written so far (live or freed)
+    uint64_t reserved[5];
+};
+
+struct Entry {
+    uint64_t id           = 0;   // workshop ID, 0 = free slot
+    uint64_t size         = 0;   // bytes in all regular files (recursive)
+    uint64_t files        = 0;   // regular file count (recursive)
+    int64_t  newestMtime  = 0;   // newest file mtime, Unix seconds
+    int64_t  manifestTime = 0;   // manifest.txt "PublishDate", Unix seconds (0 = none)
+    int64_t  dirMtime     = 0;   // folder's own mtime when scanned (native ticks)
+    uint64_t dirInode     = 0;   // folder's inode / NTFS file index when scanned
+    uint64_t reserved     = 0;
+};
+
+static_assert(sizeof(Header) == 64 && sizeof(Entry) == 64, "skin index layout changed");
+
+// Index file for a content folder outside the tool's own tree:
+//   <cacheDir>/252490-<hash of the folder's absolute path>.skinindex
+inline fs::path cachedIndexFile(const fs::path& contentDir, const fs::path& cacheDir = CACHE_DIR) {
+    std::error_code ec;
+    fs::path abs = fs::absolute(contentDir, ec).lexically_normal();
+    if (!abs.has_filename()) abs = abs.parent_path();   // trailing slash
+    uint64_t h = 1469598103934665603ULL;                // FNV-1a
+    for (char c : abs.generic_string()) {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ULL;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)h);
+    return cacheDir / (abs.filename().string() + "-" + hex + ".skinindex");
+}
+
+// Same meaning as the tools' old folderHasFiles(): something with bytes in it.
+inline bool present(const Entry& e) { return e.id != 0 && e.size > 0; }
+
+// =============================================================================
+//  FOLDER SCAN
+// =============================================================================
+
+// Workshop folder name -> ID; 0 for anything that isn't purely numeric or
+// has a leading zero. Only canonical names count, so std::to_string(id)
+// always leads back to the folder the ID came from.
+inline uint64_t parseId(const std::string& name) {
+    if (name.empty() || name.size() > 19 || name[0] == '0') return 0;
+    for (char c : name)
+        if (c < '0' || c > '9') return 0;
+    return std::strtoull(name.c_str(), nullptr, 10);
+}
+
+struct DirStamp {
+    int64_t  mtime = 0;
+    uint64_t inode = 0;
+};
+
+inline bool statDir(const fs::path& p, DirStamp& st) {
+#ifdef _WIN32
+    HANDLE h = CreateFileW(p.c_str(), FILE_READ_ATTRIBUTES,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    BY_HANDLE_FILE_INFORMATION fi;
+    BOOL ok = GetFileInformationByHandle(h, &fi);
+    CloseHandle(h);
+    if (!ok || !(fi.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return false;
+    st.mtime = (int64_t)(((uint64_t)fi.ftLastWriteTime.dwHighDateTime << 32)
+                         | fi.ftLastWriteTime.dwLowDateTime);
+    st.inode = ((uint64_t)fi.nFileIndexHigh << 32) | fi.nFileIndexLow;
+    return true;
+#else
+    struct stat sb;
+    if (::stat(p.c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) return false;
+    st.mtime = (int64_t)sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec;
+    st.inode = (uint64_t)sb.st_ino;
+    return true;
+#endif
+}
+
+inline int64_t toUnixTime(fs::file_time_type ftime) {
+    auto sys = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                   ftime - fs::file_time_type::clock::now()
+                   + std::chrono::system_clock::now());
+    return (int64_t)std::chrono::system_clock::to_time_t(sys);
+}
+
+// "PublishDate": "2025-02-04T12:09:39.8009705Z"  ->  Unix time (UTC), 0 if absent.
+inline int64_t readManifestDate(const fs::path& skinDir) {
+    std::ifstream f(skinDir / "manifest.txt");
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t k = line.find("\"PublishDate\"");
+        if (k == std::string::npos) continue;
+        size_t c = line.find(':', k + 13);
+        size_t q = c == std::string::npos ? c : line.find('"', c);
+        if (q == std::string::npos) return 0;
+        std::tm tm{};
+        if (std::sscanf(line.c_str() + q + 1, "%4d-%2d-%2dT%2d:%2d:%2d",
+                        &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                        &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) return 0;
+        tm.tm_year -= 1900;
+        tm.tm_mon  -= 1;
+#ifdef _WIN32
+        return (int64_t)_mkgmtime(&tm);
+#else
+        return (int64_t)timegm(&tm);
+#endif
+    }
+    return 0;
+}
+
+// One walk of a skin folder. The folder is stamped before the walk, so a
+// change made while walking makes the record stale instead of being missed.
+inline bool scanSkin(const fs::path& skinDir, uint64_t id, Entry& e) {
+    DirStamp st;
+    if (!statDir(skinDir, st)) return false;
+    e          = Entry{};
+    e.id       = id;
+    e.dirMtime = st.mtime;
+    e.dirInode = st.inode;
+    try {
+        for (auto& f : fs::recursive_directory_iterator(skinDir)) {
+            if (!f.is_regular_file()) continue;
+            e.files++;
+            e.size += f.file_size();
+            int64_t t = toUnixTime(f.last_write_time());
+            if (t > e.newestMtime) e.newestMtime = t;
+        }
+    } catch (...) {}
+    e.manifestTime = readManifestDate(skinDir);
+    return true;
+}
+
+// =============================================================================
+//  INDEX
+// =============================================================================
+class Index {
+public:
+    // `indexPath`: where the index file lives; empty = next to `contentDir`.
+    explicit Index(const fs::path& contentDir, const fs::path& indexPath = {}) {
+        dir = contentDir.lexically_normal();
+        if (!dir.has_filename()) dir = dir.parent_path();   // trailing slash
+        file = indexPath.empty() ? dir.parent_path() / (dir.filename().string() + ".skinindex")
+                                 : indexPath;
+    }
+    ~Index() { close(); }
+    Index(const Index&) = delete;
+    Index& operator=(const Index&) = delete;
+
+    const fs::path& contentDir() const { return dir; }
+    const fs::path& indexFile()  const { return file; }
+    bool persistent() const { return mapped; }
+
+    // Map the index file (created if missing, reset if it is from another
+    // layout). Falls back to an in-memory index; never fails.
+    void open() {
+        std::lock_guard<std::mutex> lk(mtx);
+        if (recs) return;
+        uint64_t have = openFile();
+        uint64_t cap  = have > sizeof(Header) ? (have - sizeof(Header)) / sizeof(Entry) : 0;
+        if (!mapped || !mapSlots(cap < INITIAL_SLOTS ? INITIAL_SLOTS : cap)) {
+            closeFile();
+            mem.assign(sizeof(Header) + INITIAL_SLOTS * sizeof(Entry), 0);
+            base = mem.data();
+            cap  = INITIAL_SLOTS;
+        }
+        attach();
+        if (std::memcmp(hdr->magic, MAGIC, sizeof(MAGIC)) != 0
+            || hdr->version != VERSION || hdr->recordSize != sizeof(Entry)
+            || hdr->used > slots) {
+            std::memset(base, 0, sizeof(Header) + slots * sizeof(Entry));
+            std::memcpy(hdr->magic, MAGIC, sizeof(MAGIC));
+            hdr->version    = VERSION;
+            hdr->recordSize = sizeof(Entry);
+        }
+        for (uint64_t i = 0; i < hdr->used; ++i) {
+            uint64_t id = recs[i].id;
+            if (id == 0 || !byId.emplace(id, i).second) {
+                recs[i] = Entry{};
+                freeSlots.push_back(i);
+            }
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lk(mtx);
+        unmapSlots();
+        closeFile();
+        mem.clear();
+        byId.clear();
+        freeSlots.clear();
+    }
+
+    // Cached record, no disk access. Good enough wherever this tool is the
+    // only writer (e.g. the downloader's skip check after reconcile()).
+    bool find(uint64_t id, Entry& out) {
+        std::lock_guard<std::mutex> lk(mtx);
+        auto it = byId.find(id);
+        if (it == byId.end()) return false;
+        out = recs[it->second];
+        return true;
+    }
+    bool has(uint64_t id) {
+        Entry e;
+        return find(id, e) && present(e);
+    }
+    bool has(const std::string& name) { return has(parseId(name)); }
+
+    // Record for one folder, checked against the folder with a single stat and
+    // rescanned if it changed. False (and the record dropped) if it is gone.
+    bool lookup(const std::string& name, Entry& out) {
+        uint64_t id = parseId(name);
+        if (id == 0) return false;
+        DirStamp st;
+        if (!statDir(dir / name, st)) { remove(id); return false; }
+        if (find(id, out) && out.dirMtime == st.mtime && out.dirInode == st.inode)
+            return true;
+        return rescan(name, &out);
+    }
+
+    // Walk one folder and store the result (after a tool put a skin there).
+    // Returns true if the folder is present and not empty.
+    bool rescan(const std::string& name, Entry* out = nullptr) {
+        uint64_t id = parseId(name);
+        if (id == 0) return false;
+        Entry e;
+        if (!scanSkin(dir / name, id, e)) { remove(id); return false; }
+        put(e);
+        if (out) *out = e;
+        return present(e);
+    }
+
+    void put(const Entry& e) {
+        if (e.id == 0) return;
+        std::lock_guard<std::mutex> lk(mtx);
+        if (!recs) return;
+        auto it = byId.find(e.id);
+        uint64_t slot;
+        if (it != byId.end()) {
+            slot = it->second;
+        } else if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            if (hdr->used == slots && !grow()) return;
+            slot = hdr->used++;
+        }
+        recs[slot] = e;
+        byId[e.id] = slot;
+    }
+
+    void remove(uint64_t id) {
+        std::lock_guard<std::mutex> lk(mtx);
+        auto it = byId.find(id);
+        if (it == byId.end()) return;
+        recs[it->second] = Entry{};
+        freeSlots.push_back(it->second);
+        byId.erase(it);
+    }
+
+    // One listing of the content folder: records of vanished folders are
+    // dropped, and the names of folders that are new or changed since they
+    // were indexed are returned (a stat each, no recursion).
+    // Throws fs::filesystem_error if the folder can't be listed (missing,
+    // unreadable, I/O error part-way); the index is then left as it was –
+    // an incomplete listing must not drop the records it didn't get to.
+    std::vector<std::string> reconcile() {
+        std::vector<std::string> stale;
+        std::unordered_set<uint64_t> seen;
+        for (auto& d : fs::directory_iterator(dir)) {
+            std::string name = d.path().filename().string();
+            uint64_t id = parseId(name);
+            if (id == 0) continue;
+            DirStamp st;
+            if (!statDir(d.path(), st)) continue;
+            seen.insert(id);
+            Entry e;
+            if (!find(id, e) || e.dirMtime != st.mtime || e.dirInode != st.inode)
+                stale.push_back(name);
+        }
+        std::vector<uint64_t> gone;
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            for (auto& kv : byId)
+                if (!seen.count(kv.first)) gone.push_back(kv.first);
+        }
+        for (uint64_t id : gone) remove(id);
+        return stale;
+    }
+
+    // reconcile() + rescan of everything it reported. Throws like reconcile().
+    void refresh() {
+        for (auto& name : reconcile()) rescan(name);
+    }
+
+    // Present (non-empty) skins; entries(true) also lists empty folders.
+    size_t size() {
+        std::lock_guard<std::mutex> lk(mtx);
+        size_t n = 0;
+        for (auto& kv : byId)
+            if (present(recs[kv.second])) n++;
+        return n;
+    }
+    std::vector<Entry> entries(bool includeEmpty = false) {
+        std::lock_guard<std::mutex> lk(mtx);
+        std::vector<Entry> out;
+        out.reserve(byId.size());
+        for (auto& kv : byId)
+            if (includeEmpty || present(recs[kv.second])) out.push_back(recs[kv.second]);
+        return out;
+    }
+
+private:
+    fs::path dir;
+    fs::path file;
+
+    std::mutex mtx;
+    unsigned char* base  = nullptr;
+    Header*        hdr   = nullptr;
+    Entry*         recs  = nullptr;
+    uint64_t       slots = 0;
+    bool           mapped = false;
+    std::vector<unsigned char> mem;            // in-memory fallback
+    std::unordered_map<uint64_t, uint64_t> byId;
+    std::vector<uint64_t> freeSlots;
+
+#ifdef _WIN32
+    HANDLE fh   = INVALID_HANDLE_VALUE;
+    HANDLE fmap = nullptr;
+#else
+    int    fd   = -1;
+#endif
+
+    void attach() {
+        hdr   = reinterpret_cast<Header*>(base);
+        recs  = reinterpret_cast<Entry*>(base + sizeof(Header));
+        slots = mapped ? slots
+                       : (mem.size() - sizeof(Header)) / sizeof(Entry);
+    }
+
+    bool grow() {
+        uint64_t want = slots * 2;
+        if (mapped) {
+            if (!mapSlots(want)) return false;
+        } else {
+            mem.resize(sizeof(Header) + want * sizeof(Entry), 0);
+            base = mem.data();
+        }
+        attach();
+        return true;
+    }
+
+    // Opens (or creates) the index file; returns its current size.
+    uint64_t openFile() {
+        std::error_code ec;
+        if (file.has_parent_path()) fs::create_directories(file.parent_path(), ec);
+#ifdef _WIN32
+        fh = CreateFileW(file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                         nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fh == INVALID_HANDLE_VALUE) return 0;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(fh, &sz)) return 0;
+        mapped = true;
+        return (uint64_t)sz.QuadPart;
+#else
+        fd = ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return 0;
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {   // another tool has it open
+            ::close(fd);
+            fd = -1;
+            return 0;
+        }
+        struct stat sb;
+        if (::fstat(fd, &sb) != 0) return 0;
+        mapped = true;
+        return (uint64_t)sb.st_size;
+#endif
+    }
+
+    void closeFile() {
+        mapped = false;
+#ifdef _WIN32
+        if (fh != INVALID_HANDLE_VALUE) CloseHandle(fh);
+        fh = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    // (Re)map the file at n slots, extending it if needed. The new view is
+    // mapped before the old one goes, so a failure leaves the old one usable.
+    bool mapSlots(uint64_t n) {
+        uint64_t bytes = sizeof(Header) + n * sizeof(Entry);
+#ifdef _WIN32
+        HANDLE m = CreateFileMappingW(fh, nullptr, PAGE_READWRITE,
+                                      (DWORD)(bytes >> 32), (DWORD)bytes, nullptr);
+        if (!m) return false;
+        void* v = MapViewOfFile(m, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)bytes);
+        if (!v) { CloseHandle(m); return false; }
+        unmapSlots();
+        fmap = m;
+#else
+        struct stat sb;
+        if (::fstat(fd, &sb) != 0) return false;
+        if ((uint64_t)sb.st_size < bytes && ::ftruncate(fd, (off_t)bytes) != 0) return false;
+        void* v = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (v == MAP_FAILED) return false;
+        unmapSlots();
+#endif
+        base  = static_cast<unsigned char*>(v);
+        slots = n;
+        return true;
+    }
+
+    void unmapSlots() {
+        if (mapped && base) {
+#ifdef _WIN32
+            FlushViewOfFile(base, 0);
+            UnmapViewOfFile(base);
+            if (fmap) CloseHandle(fmap);
+            fmap = nullptr;
+#else
+            ::munmap(base, sizeof(Header) + slots * sizeof(Entry));
+#endif
+        }
+        base = nullptr;
+        hdr  = nullptr;
+        recs = nullptr;
+    }
+};
+
+} // namespace skinindex
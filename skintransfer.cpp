@@ -3,6 +3,9 @@
  *
  * Moves downloaded skins from the local staging folder into the real
  * Steam workshop content directory, skipping any that are already there.
+ * Both folders are looked up through their skin index (skinindex.h), so
+ * present skins are not walked again and copied ones are recorded. The
+ * Steam folder's index is kept in skinindex_cache/ next to this tool.
  *
  * Source:  .\rust_workshop\steamapps\workshop\content\252490\
  * Default: C:\Program Files (x86)\Steam\steamapps\workshop\content\252490\
@@ -21,6 +24,8 @@
 #include <iomanip>
 #include <sstream>
 
+#include "skinindex.h"
+
 namespace fs = std::filesystem;
 
 // =============================================================================
@@ -82,36 +87,6 @@ static void log(const std::string& msg,
 // =============================================================================
 //  HELPERS
 // =============================================================================
-static bool folderHasFiles(const fs::path& p) {
-    try {
-        if (!fs::exists(p) || !fs::is_directory(p)) return false;
-        for (auto& e : fs::directory_iterator(p))
-            if (fs::is_regular_file(e) && fs::file_size(e) > 0) return true;
-    } catch (...) {}
-    return false;
-}
-
-// Count total regular files under a path (for size reporting)
-static uintmax_t countFiles(const fs::path& p) {
-    uintmax_t n = 0;
-    try {
-        for (auto& e : fs::recursive_directory_iterator(p))
-            if (fs::is_regular_file(e)) n++;
-    } catch (...) {}
-    return n;
-}
-
-// Human-readable byte size
-static std::string humanSize(uintmax_t bytes) {
-    const char* units[] = { "B", "KB", "MB", "GB", "TB" };
-    double v = (double)bytes;
-    int u = 0;
-    while (v >= 1024.0 && u < 4) { v /= 1024.0; u++; }
-    std::ostringstream ss;
-    ss << std::fixed << std::setprecision(1) << v << " " << units[u];
-    return ss.str();
-}
-
 // Progress bar printed on a single updating line
 static void printProgress(int done, int total, int moved, int skipped, int failed) {
     float pct   = total > 0 ? (done * 100.f / total) : 0.f;
@@ -171,15 +146,16 @@ static bool steamInstallPresent(const fs::path& contentDir) {
 // =============================================================================
 struct CopyResult { bool ok = false; std::string error; };
 
-static CopyResult copySkin(const fs::path& src, const fs::path& dst) {
+static CopyResult copySkin(const fs::path& src, const fs::path& dst,
+                           skinindex::Index& dstIndex) {
     CopyResult r;
     try {
         fs::create_directories(dst);
         fs::copy(src, dst,
                  fs::copy_options::recursive |
                  fs::copy_options::overwrite_existing);
-        // Verify at least one file landed
-        if (!folderHasFiles(dst)) {
+        // Verify at least one file landed (and record it in the index)
+        if (!dstIndex.rescan(dst.filename().string())) {
             r.error = "destination empty after copy";
             return r;
         }
@@ -218,23 +194,21 @@ int main() {
         return 1;
     }
 
-    // Collect skin IDs from source
+    // Collect skin IDs from source (index brought up to date, only new or
+    // changed folders are walked)
     std::vector<fs::path> skins;
+    skinindex::Index srcIndex(SOURCE_PATH);
+    srcIndex.open();
     try {
-        for (auto& entry : fs::directory_iterator(SOURCE_PATH)) {
-            if (!entry.is_directory()) continue;
-            std::string name = entry.path().filename().string();
-            if (name.empty()) continue;
-            if (!std::all_of(name.begin(), name.end(), ::isdigit)) continue;
-            if (folderHasFiles(entry.path()))
-                skins.push_back(entry.path());
-        }
+        srcIndex.refresh();
     } catch (const std::exception& ex) {
         log("ERROR reading source folder: " + std::string(ex.what()), Col::Red);
         std::cout << "\nPress Enter to exit...";
         std::cin.get();
         return 1;
     }
+    for (auto& e : srcIndex.entries())
+        skins.push_back(fs::path(SOURCE_PATH) / std::to_string(e.id));
 
     std::sort(skins.begin(), skins.end());
 
@@ -335,15 +309,20 @@ int main() {
 
     log("Destination: " + dstPath.string(), Col::Cyan);
 
+    skinindex::Index dstIndex(dstPath, skinindex::cachedIndexFile(dstPath));
+    dstIndex.open();
+    skinindex::Entry have;
+
     // -------------------------------------------------------------------------
     //  Pre-scan: how many skins need copying vs already present
     // -------------------------------------------------------------------------
     int needCopy    = 0;
     int alreadyDone = 0;
     for (auto& skin : skins) {
-        fs::path dst = dstPath / skin.filename();
-        if (folderHasFiles(dst)) alreadyDone++;
-        else                     needCopy++;
+        if (dstIndex.lookup(skin.filename().string(), have) && skinindex::present(have))
+            alreadyDone++;
+        else
+            needCopy++;
     }
 
     log("Already in Steam folder (will skip): " + std::to_string(alreadyDone), Col::Yellow);
@@ -376,7 +355,7 @@ int main() {
         fs::path    dst    = dstPath / skinId;
 
         // Skip if already present
-        if (folderHasFiles(dst)) {
+        if (dstIndex.lookup(skinId, have) && skinindex::present(have)) {
             skipped++;
             done++;
             printProgress(done, total, moved, skipped, failed);
@@ -385,7 +364,7 @@ int main() {
         }
 
         // Copy
-        CopyResult r = copySkin(skinPath, dst);
+        CopyResult r = copySkin(skinPath, dst, dstIndex);
         done++;
 
         if (r.ok) {
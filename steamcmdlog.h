@@ -0,0 +1,424 @@
+/*
+ * steamcmd Log Parser  (shared by the downloader and parserbench)
+ *
+ * Classifies steamcmd output per workshop item. Handles all result line
+ * formats seen in practice:
+ *   [AppID 252490] Download item 3511955902 result : Locking Failed
+ *   [AppID 252490] Download item 492051023  result : Failure
+ *   [AppID 252490] Update canceled: Staged file validation failed (13 missing...)
+ *   [AppID 252490] Update canceled: Failed to write patch state file (File locked)
+ *   Success. Downloaded item 1234567 to ...
+ *   ERROR! Download item 1234567 failed (Timeout).
+ *   Timeout downloading item 1234567
+ *
+ * Lines are split with memchr and matched by hand – every pattern is found
+ * anywhere in the line (steamcmd prefixes its prompt, "Steam>") exactly like
+ * the regex searches this replaced, without their per-line cost.
+ *
+ * parser_corpus/ holds recorded and synthetic logs with the result each
+ * should give; parserbench checks them and measures throughput.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace steamcmdlog {
+
+using SkinId = std::uint64_t;
+
+// =============================================================================
+//  RESULT CATEGORIES
+// =============================================================================
+enum class SkinResult : std::uint8_t {
+    Success,
+    Skipped,
+    Timeout,
+    RateLimit,
+    LockFailed,       // "result : Locking Failed" – file locked by parallel instance
+    ValidationFailed, // "Staged file validation failed" – stale/corrupt staging files
+    Error,
+    Unknown
+};
+
+inline std::string resultName(SkinResult r) {
+    switch (r) {
+        case SkinResult::Success:          return "Success";
+        case SkinResult::Skipped:          return "Skipped";
+        case SkinResult::Timeout:          return "Timeout";
+        case SkinResult::RateLimit:        return "RateLimit";
+        case SkinResult::LockFailed:       return "LockFailed";
+        case SkinResult::ValidationFailed: return "ValidationFailed";
+        case SkinResult::Error:            return "Error";
+        default:                           return "Unknown";
+    }
+}
+
+// Inverse of resultName(); false for a name it never returns.
+inline bool parseResultName(std::string_view name, SkinResult& out) {
+    for (int r = 0; r <= (int)SkinResult::Unknown; ++r) {
+        if (resultName((SkinResult)r) == name) {
+            out = (SkinResult)r;
+            return true;
+        }
+    }
+    return false;
+}
+
+// =============================================================================
+//  PARSER
+// =============================================================================
+struct ParsedLog {
+    std::unordered_map<SkinId, SkinResult> perItem;
+    bool globalRateLimit      = false;
+    bool globalTimeout        = false;
+    bool globalLockFailed     = false;
+    bool globalValidationFail = false;
+    int  rateLimitHits        = 0;   // lines that set globalRateLimit
+    int  successCount         = 0;
+    int  failureCount         = 0;
+    bool loggedIn             = false; // "Waiting for user info...OK": login is through
+};
+
+namespace scan {
+
+inline char lower(char c) { return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c; }
+inline bool lineEnd(char c) { return c == '\r' || c == '\n'; }   // what regex '.' stops at
+
+inline bool at(std::string_view s, size_t i, std::string_view lit) {
+    return s.size() >= i + lit.size() && s.compare(i, lit.size(), lit) == 0;
+}
+
+// ASCII case-insensitive `at`; `lit` is lower case.
+inline bool atNoCase(std::string_view s, size_t i, std::string_view lit) {
+    if (s.size() < i + lit.size()) return false;
+    for (size_t k = 0; k < lit.size(); ++k)
+        if (lower(s[i + k]) != lit[k]) return false;
+    return true;
+}
+
+inline size_t findNoCase(std::string_view s, std::string_view lit, size_t from = 0) {
+    for (size_t i = from; i + lit.size() <= s.size(); ++i)
+        if (lower(s[i]) == lit[0] && atNoCase(s, i, lit)) return i;
+    return std::string_view::npos;
+}
+
+// One or more digits at `i`; `id` is their value, 0 past 19 digits.
+inline bool digits(std::string_view s, size_t& i, SkinId& id) {
+    size_t b = i;
+    SkinId v = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') v = v * 10 + (SkinId)(s[i++] - '0');
+    id = (i - b) > 19 ? 0 : v;
+    return i > b;
+}
+
+// "[AppID <n>] Download item <id> result : <reason>"
+inline bool resultLine(std::string_view s, SkinId& id, std::string_view& reason) {
+    for (size_t p = s.find("[AppID "); p != std::string_view::npos; p = s.find("[AppID ", p + 1)) {
+        size_t i = p + 7;
+        SkinId app;
+        if (!digits(s, i, app) || !at(s, i, "] Download item ")) continue;
+        i += 16;
+        if (!digits(s, i, id) || !at(s, i, " result : ")) continue;
+        i += 10;
+        size_t e = i;
+        while (e < s.size() && !lineEnd(s[e])) ++e;
+        if (e == i) continue;
+        reason = s.substr(i, e - i);
+        return true;
+    }
+    return false;
+}
+
+// "<lit><id>" anywhere in the line.
+inline bool idAfter(std::string_view s, std::string_view lit, SkinId& id) {
+    for (size_t p = s.find(lit); p != std::string_view::npos; p = s.find(lit, p + 1)) {
+        size_t i = p + lit.size();
+        if (digits(s, i, id)) return true;
+    }
+    return false;
+}
+
+// "ERROR! Download item <id> failed (<reason>)"
+inline bool errorLine(std::string_view s, SkinId& id, std::string_view& reason) {
+    const std::string_view lit = "ERROR! Download item ";
+    for (size_t p = s.find(lit); p != std::string_view::npos; p = s.find(lit, p + 1)) {
+        size_t i = p + lit.size();
+        if (!digits(s, i, id) || !at(s, i, " failed (")) continue;
+        i += 9;
+        size_t close = s.find(')', i);
+        if (close == std::string_view::npos || close == i) continue;
+        reason = s.substr(i, close - i);
+        return true;
+    }
+    return false;
+}
+
+// "Staged file validation failed ... item <id>", any case, on one line.
+inline bool validationLine(std::string_view s, SkinId& id) {
+    const std::string_view lit = "staged file validation failed";
+    for (size_t p = findNoCase(s, lit); p != std::string_view::npos; p = findNoCase(s, lit, p + 1)) {
+        for (size_t i = p + lit.size(); i < s.size() && !lineEnd(s[i]); ++i) {
+            size_t d = i + 5;
+            if (atNoCase(s, i, "item ") && digits(s, d, id)) return true;
+        }
+    }
+    return false;
+}
+
+// "rate.?limit|too many requests|throttled", any case.
+inline bool rateLimitLine(std::string_view s) {
+    for (size_t p = findNoCase(s, "rate"); p != std::string_view::npos; p = findNoCase(s, "rate", p + 1)) {
+        size_t i = p + 4;
+        if (atNoCase(s, i, "limit")) return true;
+        if (i < s.size() && !lineEnd(s[i]) && atNoCase(s, i + 1, "limit")) return true;
+    }
+    return findNoCase(s, "too many requests") != std::string_view::npos
+        || findNoCase(s, "throttled")         != std::string_view::npos;
+}
+
+} // namespace scan
+
+// Incremental parser: steamcmd output is fed in as it arrives and every item
+// is reported through takeSettled() as soon as its outcome is final.
+//
+// Success and the specific failures (Timeout, RateLimit, LockFailed,
+// ValidationFailed) are final immediately. A generic Error may still be
+// refined by a following context line that has no item ID (staged validation
+// failure, patch-state lock), so it settles when the next item shows up or at
+// finish().
+class SteamCmdLogParser {
+public:
+    explicit SteamCmdLogParser(const std::vector<SkinId>& chunk) {
+        for (const auto& id : chunk) expect(id);
+    }
+
+    // Start tracking an item (persistent sessions add items as they are sent).
+    // An item sent again – a retry in the same session – is tracked afresh.
+    void expect(SkinId id) {
+        auto ins = result.perItem.emplace(id, SkinResult::Unknown);
+        if (ins.second) {
+            order.push_back(id);
+            return;
+        }
+        settle(id);
+        settledIds.erase(id);
+        ins.first->second = SkinResult::Unknown;
+        if (lastId == id) lastId = 0;
+    }
+
+    // Feed raw output; complete lines are classified immediately, straight
+    // from `data` unless a line started in an earlier chunk.
+    void feed(const char* data, size_t len) {
+        const char* p   = data;
+        const char* end = data + len;
+        if (!partial.empty()) {
+            auto nl = static_cast<const char*>(std::memchr(p, '\n', len));
+            if (!nl) {
+                partial.append(p, len);
+                return;
+            }
+            partial.append(p, nl);
+            onLine(chompCR(partial));
+            partial.clear();
+            p = nl + 1;
+        }
+        while (const char* nl = static_cast<const char*>(std::memchr(p, '\n', (size_t)(end - p)))) {
+            onLine(chompCR(std::string_view(p, (size_t)(nl - p))));
+            p = nl + 1;
+        }
+        partial.assign(p, end);
+    }
+
+    // End of output: classify a trailing partial line and settle every item.
+    void finish() {
+        if (!partial.empty()) {
+            onLine(partial);
+            partial.clear();
+        }
+        for (const auto& id : order) settle(id);
+    }
+
+    // Items that became final since the last call, in the order they settled.
+    std::vector<std::pair<SkinId, SkinResult>> takeSettled() {
+        std::vector<std::pair<SkinId, SkinResult>> out;
+        out.swap(settledQueue);
+        return out;
+    }
+
+    bool isSettled(SkinId id) const { return settledIds.count(id) > 0; }
+
+    // A result line for the item has been seen (it may still await refinement).
+    bool hasResult(SkinId id) const {
+        auto it = result.perItem.find(id);
+        return it != result.perItem.end() && it->second != SkinResult::Unknown;
+    }
+
+    const ParsedLog& parsed() const { return result; }
+
+private:
+    ParsedLog                                   result;
+    std::vector<SkinId>                         order;
+    std::unordered_set<SkinId>                  settledIds;
+    std::vector<std::pair<SkinId, SkinResult>>  settledQueue;
+    std::string                                 partial;
+    SkinId                                      lastId = 0; // context for lines that have no embedded item ID
+
+    void settle(SkinId id) {
+        auto it = result.perItem.find(id);
+        if (it == result.perItem.end() || !settledIds.insert(id).second) return;
+        settledQueue.emplace_back(id, it->second);
+    }
+
+    // Settle `id` now unless a context line could still refine it.
+    void settleIfFinal(SkinId id) {
+        auto it = result.perItem.find(id);
+        if (it == result.perItem.end()) return;
+        if (it->second != SkinResult::Error && it->second != SkinResult::Unknown)
+            settle(id);
+    }
+
+    static std::string_view chompCR(std::string_view line) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        return line;
+    }
+
+    // A new item ID ends the context window of the previous one.
+    void setLastId(SkinId id) {
+        if (lastId != 0 && lastId != id) settle(lastId);
+        lastId = id;
+    }
+
+    void onLine(std::string_view line) {
+        SkinId           id = 0;
+        std::string_view reason;
+
+        // ── Workshop log result line ─────────────────────────────────────
+        if (scan::resultLine(line, id, reason)) {
+            setLastId(id);
+
+            SkinResult sr = SkinResult::Error;
+            if (reason == "OK" || reason.find("Success") != std::string_view::npos) {
+                sr = SkinResult::Success;
+                result.successCount++;
+            } else if (reason.find("Locking Failed") != std::string_view::npos ||
+                       reason.find("locked")         != std::string_view::npos) {
+                sr = SkinResult::LockFailed;
+                result.globalLockFailed = true;
+                result.failureCount++;
+            } else if (reason.find("Timeout") != std::string_view::npos) {
+                sr = SkinResult::Timeout;
+                result.globalTimeout = true;
+                result.failureCount++;
+            } else if (reason.find("rate") != std::string_view::npos ||
+                       reason.find("Rate") != std::string_view::npos) {
+                sr = SkinResult::RateLimit;
+                result.globalRateLimit = true;
+                result.rateLimitHits++;
+                result.failureCount++;
+            } else {
+                // Generic "Failure" – may be refined by earlier/later context lines
+                sr = SkinResult::Error;
+                result.failureCount++;
+            }
+            if (result.perItem.count(id))
+                result.perItem[id] = sr;
+            settleIfFinal(id);
+            return;
+        }
+
+        // ── Staged file validation failure (with item ID) ────────────────
+        if (scan::validationLine(line, id)) {
+            if (result.perItem.count(id))
+                result.perItem[id] = SkinResult::ValidationFailed;
+            result.globalValidationFail = true;
+            settleIfFinal(id);
+            return;
+        }
+        // Staged file validation failure (no item ID – use lastId context)
+        if (line.find("Staged file validation failed") != std::string_view::npos ||
+            line.find("Missing update files")          != std::string_view::npos) {
+            result.globalValidationFail = true;
+            if (lastId != 0 && result.perItem.count(lastId) &&
+                (result.perItem[lastId] == SkinResult::Error ||
+                 result.perItem[lastId] == SkinResult::Unknown))
+                result.perItem[lastId] = SkinResult::ValidationFailed;
+            if (lastId != 0) settleIfFinal(lastId);
+            return;
+        }
+
+        // ── Patch-state lock (no item ID – use lastId context) ───────────
+        if (scan::findNoCase(line, "failed to write patch state file (file locked)")
+                != std::string_view::npos) {
+            result.globalLockFailed = true;
+            if (lastId != 0 && result.perItem.count(lastId) &&
+                (result.perItem[lastId] == SkinResult::Error ||
+                 result.perItem[lastId] == SkinResult::Unknown))
+                result.perItem[lastId] = SkinResult::LockFailed;
+            if (lastId != 0) settleIfFinal(lastId);
+            return;
+        }
+
+        // ── steamcmd "Success." console line ────────────────────────────
+        if (scan::idAfter(line, "Success. Downloaded item ", id)) {
+            if (result.perItem.count(id)) {
+                result.perItem[id] = SkinResult::Success;
+                result.successCount++;
+            }
+            setLastId(id);
+            settleIfFinal(id);
+            return;
+        }
+
+        // ── steamcmd "ERROR!" console line ──────────────────────────────
+        if (scan::errorLine(line, id, reason)) {
+            setLastId(id);
+            SkinResult sr = SkinResult::Error;
+            if (reason.find("Timeout") != std::string_view::npos) {
+                sr = SkinResult::Timeout;
+                result.globalTimeout = true;
+            } else if (reason.find("rate") != std::string_view::npos ||
+                       reason.find("Rate") != std::string_view::npos) {
+                sr = SkinResult::RateLimit;
+                result.globalRateLimit = true;
+                result.rateLimitHits++;
+            }
+            if (result.perItem.count(id)) result.perItem[id] = sr;
+            result.failureCount++;
+            settleIfFinal(id);
+            return;
+        }
+
+        // ── steamcmd "Timeout" standalone console line ───────────────────
+        if (scan::idAfter(line, "Timeout downloading item ", id)) {
+            if (result.perItem.count(id)) result.perItem[id] = SkinResult::Timeout;
+            result.globalTimeout = true;
+            result.failureCount++;
+            setLastId(id);
+            settleIfFinal(id);
+            return;
+        }
+
+        // ── Login finished ───────────────────────────────────────────────
+        if (!result.loggedIn && scan::at(line, 0, "Waiting for user info") &&
+            line.size() >= 2 && line.compare(line.size() - 2, 2, "OK") == 0) {
+            result.loggedIn = true;
+            return;
+        }
+
+        // ── Global rate-limit marker ─────────────────────────────────────
+        if (scan::rateLimitLine(line)) {
+            result.globalRateLimit = true;
+            result.rateLimitHits++;
+        }
+    }
+};
+
+} // namespace steamcmdlog